@@ -4,6 +4,7 @@
  */
 #pragma once
 
+#include <optional>
 #include <eosiolib/time.hpp>
 #include <eosiolib/eosio.hpp>
 #include <eosiolib/producer_schedule.hpp>
@@ -30,6 +31,8 @@ namespace eosio {
       block_id_type        id() const;
       uint32_t             block_num() const { return num_from_id(previous) + 1; }
       static uint32_t      num_from_id(const capi_checksum256& id);
+      static block_id_type id_from_digest(const capi_checksum256& digest, uint32_t block_num);
+      static capi_checksum256 digest_of_packed(const std::vector<char>& packed_header);
       std::optional<eosio::producer_schedule> get_ext_new_producers( uint16_t ext_id ) const;
 
       EOSLIB_SERIALIZE(block_header, (timestamp)(producer)(confirmed)(previous)(transaction_mroot)(action_mroot)
@@ -42,6 +45,35 @@ namespace eosio {
       EOSLIB_SERIALIZE_DERIVED( signed_block_header, block_header, (producer_signature) )
    };
 
+   /**
+    * A signed_block_header located inside packed data, such as the headers of pushsection and pushblkcmits.
+    * Only the fields used to check the header chain are decoded, the digest is computed over the original
+    * bytes instead of a re-serialization, and the full header is unpacked only when it is stored.
+    * The digest is memoized, block id and signature digest share one hash per header. The memo lives here
+    * and not in block_header, whose fields all appear in the chaindb table abi.
+    */
+   struct signed_block_header_view {
+      const char*          begin = nullptr;     // packed signed_block_header
+      size_t               size = 0;
+      block_timestamp      timestamp;
+      name                 producer;
+      uint16_t             confirmed = 0;
+      block_id_type        previous;
+      uint32_t             schedule_version = 0;
+      bool                 has_new_producers = false;
+
+      capi_checksum256     digest()const;       // equal to block_header::digest()
+      block_id_type        id()const;
+      uint32_t             block_num()const { return block_header::num_from_id(previous) + 1; }
+      signed_block_header  get_header()const;
+
+   private:
+      mutable std::optional<capi_checksum256>   _digest;
+   };
+
+   signed_block_header_view get_header_view( datastream<const char*>& ds );
+   std::vector<signed_block_header_view> get_header_views( const std::vector<char>& headers_data );
+
    struct key_weight {
       public_key        key;
       uint16_t          weight;
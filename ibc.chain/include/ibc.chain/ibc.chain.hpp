@@ -13,12 +13,17 @@
 
 namespace eosio {
 
-   const static uint32_t section_max_length = 1000;   // used under pipeline consensus algorithm
    const static uint32_t lib_depth = 325;             // don't modify, used under pipeline consensus algorithm
    const static uint32_t prodsches_max_records = 5;
    const static uint32_t sections_max_records = 5;
    const static uint32_t producer_repetitions = 12;   // don't modify
+   const static uint32_t producer_history_length = 21;   // producer changes a section remembers, don't modify
+   const static uint32_t merkle_snapshot_interval = 32;  // pipeline headers whose block_num is a multiple store blockroot_merkle
+   const static uint32_t fork_staging_depth = 24;     // blocks behind the last header a staged branch may fork at, two producer rounds
    const static uint32_t chaindb_max_history_length = 60;   // uint: minutes
+   const static uint32_t pbft_quorum = 15;            // distinct producers whose commits or checkpoints prove a batch
+   const static uint32_t gc_default_row_budget = 150; // rows the garbage collector may visit per action besides one per pushed header
+   const static uint64_t mmr_pending_leaf = ~uint64_t(0);   // leaf_index of an anchor block not appended to anchormmr yet
 
    const static bool     check_relay_auth = true;
 
@@ -45,13 +50,55 @@ namespace eosio {
    };
    typedef eosio::singleton< "globalm"_n, global_mutable > global_mutable_singleton;
 
+   /**
+    * State of the garbage collector run at the end of pushsection and pushblkcmits.
+    * Non anchor blocks below cursor have already been collected.
+    */
+   struct [[eosio::table("gcstate"), eosio::contract("ibc.chain")]] gc_state {
+      gc_state(){}
+      uint64_t                cursor = 0;
+      uint32_t                row_budget = gc_default_row_budget;
+      std::vector<uint64_t>   restored_anchors;   // block numbers of the anchors rows stored again by restoreanchor
+
+      EOSLIB_SERIALIZE( gc_state, (cursor)(row_budget)(restored_anchors) )
+   };
+   typedef eosio::singleton< "gcstate"_n, gc_state > gc_state_singleton;
+
+   /**
+    * Progress of a reset of the light client started by forceinit or by chaininit of _self,
+    * which clears sections, prodsches, chaindb and anchors in this order over as many calls as needed.
+    */
+   struct [[eosio::table("resetstate"), eosio::contract("ibc.chain")]] reset_state {
+      reset_state(){}
+      name        stage;              // table being cleared, empty when no reset is in progress
+      uint64_t    rows_erased = 0;    // since the reset started
+
+      EOSLIB_SERIALIZE( reset_state, (stage)(rows_erased) )
+   };
+   typedef eosio::singleton< "resetstate"_n, reset_state > reset_state_singleton;
+
+   /**
+    * Turns of the registered relays, so that they do not all push the same headers and cash the same transfers.
+    * Time is cut into turns of turn_length seconds, turn n belongs to relay n % size of relays, in the order of the relays table.
+    * Once takeover_timeout seconds of a turn have passed without a push of its relay, any registered relay may act until the turn ends.
+    */
+   struct [[eosio::table("relayturn"), eosio::contract("ibc.chain")]] relay_turn {
+      relay_turn(){}
+      uint32_t    turn_length = 0;        // uint: seconds, 0 disables turns
+      uint32_t    takeover_timeout = 0;   // uint: seconds
+      uint64_t    served_turn = 0;        // last turn in which its own relay pushed headers
+
+      EOSLIB_SERIALIZE( relay_turn, (turn_length)(takeover_timeout)(served_turn) )
+   };
+   typedef eosio::singleton< "relayturn"_n, relay_turn > relay_turn_singleton;
+
    struct [[eosio::table("chaindb"), eosio::contract("ibc.chain")]] block_header_state {
       uint64_t                   block_num;
       block_id_type              block_id;
       signed_block_header        header;
       uint32_t                   active_schedule_id;
       uint32_t                   pending_schedule_id;
-      incremental_merkle         blockroot_merkle;
+      incremental_merkle         blockroot_merkle;    // empty if not a snapshot, see chain::load_blockroot_merkle
       capi_public_key            block_signing_key;   // redundant, used for make signature verification faster
       bool                       is_anchor_block = false;
 
@@ -62,35 +109,193 @@ namespace eosio {
    };
    typedef eosio::multi_index< "chaindb"_n, block_header_state > chaindb;
 
+   /**
+    * Compact copy of the anchor blocks in chaindb, the only data other contracts need to verify transactions.
+    * A row exists while the chaindb row of the same block has is_anchor_block set, or once restored by action
+    * restoreanchor until the garbage collector runs again.
+    */
+   struct [[eosio::table("anchors"), eosio::contract("ibc.chain")]] anchor_block {
+      uint64_t                   block_num;
+      uint64_t                   leaf_index = mmr_pending_leaf;   // in table anchormmr, set once the block is irreversible
+      block_id_type              block_id;
+      digest_type                transaction_mroot;
+      uint64_t                   merkle_layers;    // bit n - 1 set if blockroot_merkle has a node at layer n
+      std::vector<digest_type>   merkle_nodes;     // these nodes, in ascending layer order
+
+      uint64_t primary_key()const { return block_num; }
+
+      EOSLIB_SERIALIZE( anchor_block, (block_num)(leaf_index)(block_id)(transaction_mroot)(merkle_layers)(merkle_nodes) )
+   };
+   typedef eosio::multi_index< "anchors"_n, anchor_block > anchors;
+
+   /// an anchor block no longer in table anchors and the sibling hashes from its leaf up to the peak of its tree in anchormmr
+   struct anchor_mmr_proof {
+      anchor_block               anchor;
+      std::vector<digest_type>   path;
+
+      EOSLIB_SERIALIZE( anchor_mmr_proof, (anchor)(path) )
+   };
+
+   /**
+    * Merkle mountain range of the irreversible anchor blocks since the light client was initialized, its leaves are the
+    * sha256 of the packed anchors rows, in block number order. peaks are the roots of its perfect trees,
+    * the highest first, one per bit set in leaf_count, so appending costs at most log2(leaf_count) + 1 hashes.
+    */
+   struct [[eosio::table("anchormmr"), eosio::contract("ibc.chain")]] anchor_mmr {
+      anchor_mmr(){}
+      uint64_t                   leaf_count = 0;
+      std::vector<digest_type>   peaks;
+      uint64_t                   last_block_num = 0;   // of the last anchor block appended
+
+      static digest_type parent( const digest_type& left, const digest_type& right ){
+         return get_checksum256( left, right );
+      }
+
+      void append( digest_type node ){
+         for ( uint64_t count = leaf_count; count & 1; count >>= 1 ){
+            node = parent( peaks.back(), node );
+            peaks.pop_back();
+         }
+         peaks.push_back( node );
+         ++leaf_count;
+      }
+
+      // path holds the siblings of leaf from the bottom up to the peak of its tree
+      bool contains( uint64_t index, digest_type node, const std::vector<digest_type>& path )const {
+         if ( index >= leaf_count ){ return false; }
+         uint64_t offset = 0;
+         size_t peak = 0;
+         for ( int height = 63; height >= 0; --height ){
+            uint64_t size = uint64_t(1) << height;
+            if ( ! ( leaf_count & size ) ){ continue; }
+            if ( index < offset + size ){
+               if ( path.size() != size_t(height) ){ return false; }
+               uint64_t position = index - offset;
+               for ( const auto& sibling : path ){
+                  node = position & 1 ? parent( sibling, node ) : parent( node, sibling );
+                  position >>= 1;
+               }
+               return is_equal_capi_checksum256( node, peaks[peak] );
+            }
+            offset += size;
+            ++peak;
+         }
+         return false;
+      }
+
+      EOSLIB_SERIALIZE( anchor_mmr, (leaf_count)(peaks)(last_block_num) )
+   };
+   typedef eosio::singleton< "anchormmr"_n, anchor_mmr > anchor_mmr_singleton;
+
+   struct producer_key_index {
+      name              producer;
+      capi_public_key   key;        // serialized block_signing_key
+      uint16_t          position;   // in schedule.producers
+
+      EOSLIB_SERIALIZE( producer_key_index, (producer)(key)(position) )
+   };
+
    struct [[eosio::table("prodsches"), eosio::contract("ibc.chain")]] producer_schedule_type {
       uint64_t                      id;
       producer_schedule             schedule;
       digest_type                   schedule_hash;
+      std::vector<producer_key_index>     producer_keys;    // lookup index of schedule, sorted by producer, then position
+      std::vector<uint16_t>         key_order;        // positions in producer_keys, sorted by key, then position
 
       uint64_t primary_key()const { return id; }
+      void build_producer_index();  // must be called whenever schedule is set
+      const producer_key_index* find_by_producer( name producer ) const;
+      const producer_key_index* find_last_by_producer( name producer ) const;
+      const producer_key_index* find_by_key( const capi_public_key& key ) const;
 
-      EOSLIB_SERIALIZE( producer_schedule_type, (id)(schedule)(schedule_hash) )
+      EOSLIB_SERIALIZE( producer_schedule_type, (id)(schedule)(schedule_hash)(producer_keys)(key_order) )
    };
    typedef eosio::multi_index< "prodsches"_n, producer_schedule_type >  prodsches;
 
+   struct producer_confirmation {
+      name        producer;
+      uint32_t    block_num;     // the last block it produced
+
+      EOSLIB_SERIALIZE( producer_confirmation, (producer)(block_num) )
+   };
+
    struct [[eosio::table("sections"), eosio::contract("ibc.chain")]] section_type {
       uint64_t                first;
       uint64_t                last;
       uint64_t                newprod_block_num = 0;  /// 0 means all headers' header.new_producers in this section is empty
       bool                    valid = false;
+
+      /// ring buffers of producer_history_length slots holding the last producers and the first block number of each,
+      /// allocated when the first producer is added, the oldest entry is at producers_head
       std::vector<name>       producers;
       std::vector<uint32_t>   block_nums;
+      uint8_t                 producers_head = 0;
+      uint8_t                 producers_size = 0;
+
+      /// proposed last irreversible block from the confirmed counts of the headers, dpos_proposed_irreversible_blocknum
+      /// of nodeos, tracked from the section root, the last fork and the last producer replacement on, see confirm().
+      /// nodeos makes a block final only a round of confirmations later, at dpos_irreversible_blocknum, the light client
+      /// treats the proposed one as final: anchor blocks up to it enter anchormmr and forks before it are rejected
+      uint64_t                               proposed_lib_num = 0;   /// last block confirmed by 2/3+1 producers of the active schedule
+      std::vector<uint8_t>                   confirm_count;          /// confirmations still needed by the blocks up to last
+      std::vector<producer_confirmation>     last_produced;
 
       uint64_t primary_key()const { return first; }
       
       /// important function, used to prevent attack
-      void add( name producer, uint32_t num, uint32_t tslot = 0, const producer_schedule& sch = producer_schedule() ); 
+      void add( name producer, uint32_t num, uint32_t tslot = 0, const producer_schedule_type& sch = producer_schedule_type() );
       void clear_from( uint32_t num );
+      void clear_producers(){ producers_head = 0; producers_size = 0; }
+      void confirm( name producer, uint32_t num, uint16_t confirmed, uint32_t required_confs, uint32_t skipped = 0 );
+      void clear_confirmations(){ confirm_count.clear(); last_produced.clear(); }
+
+      /// i-th producer counting back from the last one, i must be less than producers_size
+      name     producer_back( uint32_t i = 0 )const { return producers[ slot_back(i) ]; }
+      uint32_t block_num_back( uint32_t i = 0 )const { return block_nums[ slot_back(i) ]; }
 
-      EOSLIB_SERIALIZE( section_type, (first)(last)(newprod_block_num)(valid)(producers)(block_nums) )
+      EOSLIB_SERIALIZE( section_type, (first)(last)(newprod_block_num)(valid)(producers)(block_nums)(producers_head)(producers_size)
+                                      (proposed_lib_num)(confirm_count)(last_produced) )
+
+   private:
+      uint32_t slot_back( uint32_t i )const { return ( producers_head + producers_size - 1 - i ) % producer_history_length; }
    };
    typedef eosio::multi_index< "sections"_n, section_type >  sections;
 
+   /**
+    * Headers of branches competing with the last section near its last header, verified but not stored in chaindb
+    * until their branch is longer than the stored one or irreversible, see chain::stage_header()
+    */
+   struct [[eosio::table("forkdb"), eosio::contract("ibc.chain")]] staged_header {
+      uint64_t                   key;        // block number in the high 32 bits, 4 bytes of the block id in the low ones
+      block_header_state         state;      // with the whole blockroot_merkle
+      uint64_t                   fork_num;   // first header of the branch, whose parent is stored
+      section_type               branch;     // the last section as it would be with the branch up to this header
+
+      uint64_t primary_key()const { return key; }
+
+      EOSLIB_SERIALIZE( staged_header, (key)(state)(fork_num)(branch) )
+   };
+   typedef eosio::multi_index< "forkdb"_n, staged_header > forkdb;
+
+   /**
+    * State of the light client at its last anchor block, written by action checkpoint and accepted by bootstrap,
+    * which starts a light client from it with that anchor block usable at once.
+    * The signature of anchor_header is checked against active_schedule, blockroot_merkle and pending_schedule.
+    */
+   struct [[eosio::table("checkpoint"), eosio::contract("ibc.chain")]] light_client_checkpoint {
+      chain_id_type           chain_id;
+      name                    consensus_algo;
+      signed_block_header     anchor_header;
+      producer_schedule       active_schedule;
+      producer_schedule       pending_schedule;    // equal to active_schedule unless a producer replacement is in progress
+      incremental_merkle      blockroot_merkle;    // of anchor_header
+      section_type            section;             // section at anchor_header, first and last are its block number
+
+      EOSLIB_SERIALIZE( light_client_checkpoint, (chain_id)(consensus_algo)(anchor_header)(active_schedule)(pending_schedule)
+                                                 (blockroot_merkle)(section) )
+   };
+   typedef eosio::singleton< "checkpoint"_n, light_client_checkpoint > checkpoint_singleton;
+
    struct [[eosio::table("relays"), eosio::contract("ibc.chain")]] relay_account {
       name    relay;
 
@@ -107,20 +312,62 @@ namespace eosio {
    };
    typedef eosio::singleton< "wtmsig"_n, wtmsig_struct > wtmsig_singleton;
 
+   /**
+    * The last stored header and the rows it depends on, kept in memory across the headers of one pushsection
+    * or pushblkcmits, so that a header does not read back what the previous one has just written.
+    * Only the fields of block_header_state the next header needs are kept.
+    * Changes of the last section are made on the copy here and written once by flush_tip_section().
+    */
+   struct chain_tip {
+      uint32_t                         block_num = 0;          // 0 means nothing cached
+      block_id_type                    block_id;
+      name                             producer;
+      uint32_t                         schedule_version = 0;
+      uint64_t                         active_schedule_id = 0;
+      uint64_t                         pending_schedule_id = 0;
+      incremental_merkle               blockroot_merkle;
+      capi_public_key                  block_signing_key;
+
+      section_type                     section;                      // last row of sections
+      uint64_t                         section_key = 0;              // primary key of its stored row
+      bool                             section_loaded = false;
+      bool                             section_dirty = false;
+      const producer_schedule_type*    active_schedule = nullptr;    // row of active_schedule_id
+
+      void set( const block_header_state& bhs );
+   };
+
+   /**
+    * One deployment runs a light client per peer chain. Every action takes the name of its peer chain first,
+    * all tables but admin are scoped by it.
+    */
    class [[eosio::contract("ibc.chain")]] chain : public contract {
    private:
+      name                       _chain_name;
       global_state_singleton     _global_state;
       global_state               _gstate;
       global_mutable_singleton   _global_mutable;
       global_mutable             _gmutable;
+      gc_state_singleton         _gc_sg;
+      gc_state                   _gc_st;
+      reset_state_singleton      _reset_sg;
+      reset_state                _reset_st;
+      relay_turn_singleton       _turn_sg;
+      relay_turn                 _turn_st;
+      anchor_mmr_singleton       _mmr_sg;
+      anchor_mmr                 _mmr_st;
       admin_singleton            _admin_sg;
       admin_struct               _admin_st;
       wtmsig_singleton           _wtmsig_sg;
       wtmsig_struct              _wtmsig_st;
       chaindb                    _chaindb;
+      forkdb                     _forkdb;
+      anchors                    _anchors;
       prodsches                  _prodsches;
       sections                   _sections;
       relays                     _relays;
+      chain_tip                  _tip;
+      uint32_t                   _stored_headers = 0;    // by this action, in chaindb or forkdb
 
    public:
       chain( name s, name code, datastream<const char*> ds );
@@ -134,107 +381,250 @@ namespace eosio {
                       uint32_t          wtmsig_ext_id );
 
       [[eosio::action]]
-      void setadmin( name  admin );
+      void setadmin( name admin );
+
+      [[eosio::action]]
+      void setgc( const name& chain_name, uint32_t row_budget );
 
       [[eosio::action]]
-      void chaininit( const std::vector<char>&     header,
+      void setturns( const name& chain_name, uint32_t turn_length, uint32_t takeover_timeout );
+
+      [[eosio::action]]
+      void chaininit( const name&                  chain_name,
+                      const std::vector<char>&     header,
                       const producer_schedule&     active_schedule,
                       const incremental_merkle&    blockroot_merkle,
                       const name&                  relay );
 
+      // init from a checkpoint written by action checkpoint of another light client of the same chain
+      [[eosio::action]]
+      void bootstrap( const name&                      chain_name,
+                      const light_client_checkpoint&   checkpoint,
+                      const name&                      relay );
+
+      // write the state of the light client at its last anchor block to table checkpoint
+      [[eosio::action]]
+      void checkpoint( const name& chain_name, const name& relay );
+
       // push a batch of blocks, called by ibc plugin, used under pipeline consensus algorithm
       [[eosio::action]]
-      void pushsection( const std::vector<char>&    headers,
+      void pushsection( const name&                 chain_name,
+                        const std::vector<char>&    headers,
                         const incremental_merkle&   blockroot_merkle,
                         const name&                 relay );
 
-      // remove first section data, called by ibc plugin repeatedly, used under pipeline consensus algorithm
+      // push the first header of each producer round, skipped_ids are the block ids between them,
+      // used under pipeline consensus algorithm
+      [[eosio::action]]
+      void pushrounds( const name&                         chain_name,
+                       const std::vector<char>&            headers,
+                       const std::vector<block_id_type>&   skipped_ids,
+                       const name&                         relay );
+
+      // run the garbage collector once more, kept for relays which still call it, used under pipeline consensus algorithm
       [[eosio::action]]
-      void rmfirstsctn( const name& relay );
+      void rmfirstsctn( const name& chain_name, const name& relay );
 
       [[eosio::action]]
-      void relay( string action, name relay );
+      void relay( const name& chain_name, string action, name relay );
 
       // push a small batch of blocks and related commits, called by ibc plugin, used under batch consensus algorithm
       [[eosio::action]]
-      void pushblkcmits( const std::vector<char>&    headers,
+      void pushblkcmits( const name&                 chain_name,
+                         const std::vector<char>&    headers,
                          const incremental_merkle&   blockroot_merkle,
                          const std::vector<char>&    proof_data,
                          const name&                 proof_type,
                          const name&                 relay );
 
+      // store again an anchor block erased by the garbage collector, proven by its path in table anchormmr,
+      // so that assert_anchor_block_and_merkle_node and assert_anchor_block_and_transaction_mroot accept it in the same transaction
+      [[eosio::action]]
+      void restoreanchor( const name&                        chain_name,
+                          const anchor_block&                anchor,
+                          const std::vector<digest_type>&    mmr_path,
+                          const name&                        relay );
+
+      /**
+       * Very important function, used by other contracts to verifying transactions of anchor blocks no longer in table anchors
+       */
+      static void assert_anchor_in_mmr( const name&                        ibc_chain_contract,
+                                        const name&                        chain_name,
+                                        const anchor_block&                anchor,
+                                        const std::vector<digest_type>&    mmr_path ) {
+         anchor_mmr_singleton mmr_sg( ibc_chain_contract, chain_name.value );
+         eosio_assert( mmr_sg.exists(), "table anchormmr is empty");
+         eosio_assert( mmr_sg.get().contains( anchor.leaf_index, get_checksum256( anchor ), mmr_path ),
+                       (string("block ") + std::to_string(anchor.block_num) + " is not a historical anchor block").c_str());
+      }
+
+      /**
+       * Anchor block block_num, read from table anchors if proof_data is empty, or else a packed anchor_mmr_proof
+       * of it checked against table anchormmr, for anchor blocks the garbage collector has erased
+       */
+      static anchor_block get_anchor_block( const name&                ibc_chain_contract,
+                                            const name&                chain_name,
+                                            const uint32_t&            block_num,
+                                            const std::vector<char>&   proof_data ) {
+         if ( proof_data.empty() ){
+            anchors _anchors( ibc_chain_contract, chain_name.value );
+            auto anchor = _anchors.find( block_num );
+            eosio_assert( anchor != _anchors.end(), (string("block ") + std::to_string(block_num) + " is not anchor block").c_str());
+            return *anchor;
+         }
+         auto proof = unpack<anchor_mmr_proof>( proof_data );
+         eosio_assert( proof.anchor.block_num == block_num, "anchor_mmr_proof is not of the anchor block");
+         assert_anchor_in_mmr( ibc_chain_contract, chain_name, proof.anchor, proof.path );
+         return proof.anchor;
+      }
+
+      /**
+       * Very important functions, used by other contracts to verifying transactions against an anchor block of get_anchor_block
+       */
+      static void assert_merkle_node( const anchor_block& anchor, const uint32_t& layer, const digest_type& digest ) {
+         const auto& node = get_layer_node( anchor.merkle_layers, anchor.merkle_nodes, layer );
+         eosio_assert( is_equal_capi_checksum256( node, digest ), "checksum256 not equal");
+      }
+
+      static void assert_transaction_mroot( const anchor_block& anchor, const digest_type& transaction_mroot ) {
+         eosio_assert( is_equal_capi_checksum256( anchor.transaction_mroot, transaction_mroot ), "provided transaction_mroot not correct");
+      }
+
       /**
        * Very important function, used by other contracts to verifying transactions
        */
       static void assert_anchor_block_and_merkle_node( const name&          ibc_chain_contract,
+                                                       const name&          chain_name,
                                                        const uint32_t&      block_num,
                                                        const uint32_t&      layer,
                                                        const digest_type&   digest ) {
-         chaindb _chaindb( ibc_chain_contract, ibc_chain_contract.value );
-         eosio_assert( _chaindb.begin() != _chaindb.end(), (string("_chaindb of scpoe: ") + ibc_chain_contract.to_string() + " not exist").c_str());
-         auto bhs = _chaindb.get( block_num );
-         eosio_assert( bhs.is_anchor_block, (string("block ") + std::to_string(block_num) + " is not anchor block").c_str());
-         eosio_assert( is_equal_capi_checksum256( get_inc_merkle_node_by_layer(bhs.blockroot_merkle,layer), digest ), "checksum256 not equal");
+         anchors _anchors( ibc_chain_contract, chain_name.value );
+         auto anchor = _anchors.find( block_num );
+         eosio_assert( anchor != _anchors.end(), (string("block ") + std::to_string(block_num) + " is not anchor block").c_str());
+         assert_merkle_node( *anchor, layer, digest );
       }
 
       /**
        * Very important function, used by other contracts to verifying transactions
        */
       static void assert_anchor_block_and_transaction_mroot( const name&          ibc_chain_contract,
+                                                             const name&          chain_name,
                                                              const uint32_t&      block_num,
                                                              const digest_type&   transaction_mroot ) {
-         chaindb _chaindb( ibc_chain_contract, ibc_chain_contract.value );
-         eosio_assert( _chaindb.begin() != _chaindb.end(), (string("_chaindb of scpoe: ") + ibc_chain_contract.to_string() + " not exist").c_str());
-         auto bhs = _chaindb.get( block_num );
-         eosio_assert( bhs.is_anchor_block, (string("block ") + std::to_string(block_num) + " is not anchor block").c_str());
-         eosio_assert( is_equal_capi_checksum256( bhs.header.transaction_mroot, transaction_mroot ), "provided transaction_mroot not correct");
+         anchors _anchors( ibc_chain_contract, chain_name.value );
+         auto anchor = _anchors.find( block_num );
+         eosio_assert( anchor != _anchors.end(), (string("block ") + std::to_string(block_num) + " is not anchor block").c_str());
+         assert_transaction_mroot( *anchor, transaction_mroot );
       }
 
-      static void require_relay_auth( name ibc_contract_account, name relay ) {
+      static void require_relay_auth( name ibc_contract_account, name chain_name, name relay ) {
          if ( check_relay_auth ) {
-            relays _relays( ibc_contract_account, ibc_contract_account.value );
+            relays _relays( ibc_contract_account, chain_name.value );
             auto it = _relays.find( relay.value );
             eosio_assert( it != _relays.end(), "this account is not registered as relay");
             require_auth( relay );
          }
       }
 
+      /**
+       * Asserts that relay may act now according to the relayturn table of the light client of chain_name,
+       * returns true if the current turn is its own.
+       */
+      static bool require_relay_turn( name ibc_contract_account, name chain_name, name relay ) {
+         relay_turn_singleton turn_sg( ibc_contract_account, chain_name.value );
+         if ( ! turn_sg.exists() ) return false;
+         const auto turn = turn_sg.get();
+         if ( turn.turn_length == 0 ) return false;
+
+         const uint32_t time = now();
+         const uint64_t current = time / turn.turn_length;
+         if ( turn_relay( ibc_contract_account, chain_name, current ) == relay ) return true;
+
+         eosio_assert( turn.served_turn != current && time % turn.turn_length >= turn.takeover_timeout, "not the turn of this relay" );
+         return false;
+      }
+
+      static name turn_relay( name ibc_contract_account, name chain_name, uint64_t turn ) {
+         relays _relays( ibc_contract_account, chain_name.value );
+         uint64_t count = 0;
+         for ( auto it = _relays.begin(); it != _relays.end(); ++it ) ++count;
+         if ( count == 0 ) return name();
+
+         auto it = _relays.begin();
+         for ( uint64_t i = turn % count; i > 0; --i ) ++it;
+         return it->relay;
+      }
+
       // this action maybe needed when repairing the ibc system manually
       [[eosio::action]]
-      void forceinit( );
+      void forceinit( const name& chain_name );
 
       [[eosio::action]]
-      void reqrelayauth( );
+      void reqrelayauth( const name& chain_name );
 
    private:
       // pipeline pbft related
-      void new_section( const signed_block_header& header, const incremental_merkle& blockroot_merkle );
-      void append_header( const signed_block_header& header );
-      uint32_t get_section_last_active_schedule_id( const section_type& section ) const;
+      void new_section( const signed_block_header_view& header, const incremental_merkle& blockroot_merkle );
+      void append_header( const signed_block_header_view& header );
+      void append_round_header( const signed_block_header_view& header,
+                                std::vector<block_id_type>::const_iterator& skipped_itr,
+                                std::vector<block_id_type>::const_iterator skipped_end );
+      void mark_anchor_block( );
+      void update_section_valid( uint32_t header_block_num );
+      void store_header( block_header_state& bhs );
+      bool stage_header( const signed_block_header_view& header, const block_id_type& block_id );
+      void promote_branch( const block_id_type& block_id, bool force = false );
       bool remove_invalid_last_section( );
       void trim_last_section_or_not( );
 
       // batch pbft related
-      void push_header( const signed_block_header& header,
+      void push_header( const signed_block_header_view& header,
                         const incremental_merkle& blockroot_merkle = incremental_merkle() );
 
       // common
+      bool prepare_init( const name& relay );
       void remove_header_if_exist( uint32_t block_num );
+      bool is_stored_header( uint32_t block_num, const block_id_type& block_id );
+      bool is_staged_header( uint32_t block_num, const block_id_type& block_id );
+      void stage_stored_headers( uint32_t fork_num );
+      chaindb::const_iterator erase_header( chaindb::const_iterator itr );
+      void store_anchor( const block_header_state& bhs, bool irreversible );
+      void append_irreversible_anchors( );
+      incremental_merkle load_blockroot_merkle( chaindb::const_iterator itr );
+      void collect_garbage( uint32_t pushed_headers );
+      void take_relay_turn( const name& relay );
+      void serve_relay_turn();
+      bool reset_light_client( );
+
+      // working tip
+      chain_tip&                 get_tip( uint32_t block_num = 0 );   // 0 for the last row of chaindb
+      const section_type&        tip_section();
+      section_type&              modify_tip_section();
+      void                       flush_tip_section();
+      void                       reload_tip_section();
+      const producer_schedule_type&   tip_active_schedule();
 
       // producer schedule related
       capi_public_key   get_public_key_by_producer( uint64_t id, const name& producer ) const;
       name              get_producer_by_public_key( uint64_t id, const capi_public_key& public_key ) const;
 
       // producer signature related
-      digest_type       bhs_sig_digest( const block_header_state& hs ) const;
+      digest_type       bhs_sig_digest( const block_header_state& hs, const digest_type& header_digest ) const;
       void              assert_producer_signature( const digest_type& digest,
                                                    const capi_signature& signature,
                                                    const capi_public_key& pub_key ) const;
-      capi_public_key   get_public_key_form_signature( digest_type digest, signature_type sig ) const;
+      capi_public_key   get_public_key_form_signature( const digest_type& digest, const signature_type& sig ) const;
+
+      // pbft proof related
+      template<typename Message>
+      uint32_t          count_proof_producers( const std::vector<Message>& messages,
+                                               const std::vector<std::pair<block_id_type, uint64_t>>& verified,
+                                               uint32_t first_num, uint32_t quorum ) const;
 
       bool only_one_eosio_bp();
 
       void check_admin_auth();
+      void check_chain_name( const name& chain_name );   // the scope of the tables, initialized by setglobal
 
       digest_type get_schedule_hash( producer_schedule new_producers );
    };
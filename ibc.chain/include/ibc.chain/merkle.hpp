@@ -17,14 +17,40 @@ namespace eosio {
       return std::make_pair(make_canonical_left(l), make_canonical_right(r));
    }
 
-   inline auto sha256hash(std::pair<digest_type,digest_type> pair_data){
-      std::vector<char> buf = pack(pair_data);
+   /**
+    * The pair hashing kernel, sha256 of the 64 bytes l|r, the same as sha256 of pack(std::make_pair(l, r)),
+    * computed over a stack buffer so that no heap allocation is made per hashed node
+    */
+   inline digest_type sha256hash( const digest_type& l, const digest_type& r ){
+      char buf[64];
+      std::memcpy( buf, l.hash, 32 );
+      std::memcpy( buf + 32, r.hash, 32 );
       ::capi_checksum256 hash;
-      ::sha256( reinterpret_cast<char*>(buf.data()), buf.size(), &hash );
+      ::sha256( buf, sizeof(buf), &hash );
+      return hash;
+   }
+
+   inline digest_type sha256hash( const std::pair<digest_type,digest_type>& pair_data ){
+      return sha256hash( pair_data.first, pair_data.second );
+   }
+
+   /**
+    * sha256hash( make_canonical_pair(l, r) ), with the canonical flags set in the buffer instead of on copies
+    */
+   inline digest_type canonical_pair_hash( const digest_type& l, const digest_type& r ){
+      char buf[64];
+      std::memcpy( buf, l.hash, 32 );
+      std::memcpy( buf + 32, r.hash, 32 );
+      buf[0] &= 0x7F;
+      buf[32] |= 0x80;
+      ::capi_checksum256 hash;
+      ::sha256( buf, sizeof(buf), &hash );
       return hash;
    }
 
    namespace detail {
+      constexpr int max_merkle_depth = 64;
+
       constexpr uint64_t next_power_of_2(uint64_t value) {
          value -= 1;
          value |= value >> 1;
@@ -51,6 +77,12 @@ namespace eosio {
          return lz;
       }
 
+      constexpr int count_ones(uint64_t value) {
+         int count = 0;
+         for ( ; value; value &= value - 1 ) count++;
+         return count;
+      }
+
       constexpr int calcluate_max_depth(uint64_t node_count) {
          if (node_count == 0) {
             return 0;
@@ -93,8 +125,11 @@ namespace eosio {
          auto index = _node_count;
          auto top = digest;
          auto active_iter = _active_nodes.begin();
-         auto updated_active_nodes = std::vector<digest_type>();
-         updated_active_nodes.reserve(max_depth);
+
+         // at most one node per level, kept on the stack to avoid a heap allocation per append
+         eosio_assert( max_depth <= detail::max_merkle_depth, "incremental merkle too deep" );
+         digest_type updated_active_nodes[detail::max_merkle_depth];
+         size_t updated_count = 0;
 
          while (current_depth > 0) {
             if (!(index & 0x1)) {
@@ -104,12 +139,12 @@ namespace eosio {
                // if we have encountered a partial node during collapse this cannot be
                // fully-realized
                if (!partial) {
-                  updated_active_nodes.emplace_back(top);
+                  updated_active_nodes[updated_count++] = top;
                }
 
                // calculate the partially realized node value by implying the "right" value is identical
                // to the "left" value
-               top = sha256hash(make_canonical_pair(top, top));
+               top = canonical_pair_hash(top, top);
                partial = true;
             } else {
                // we are collapsing from a "right" value and an fully-realized "left"
@@ -120,11 +155,11 @@ namespace eosio {
                // if the "right" value is a partial node we will need to copy the "left" as future appends still need it
                // otherwise, it can be dropped from the set of active nodes as we are collapsing a fully-realized node
                if (partial) {
-                  updated_active_nodes.emplace_back(left_value);
+                  updated_active_nodes[updated_count++] = left_value;
                }
 
                // calculate the node
-               top = sha256hash(make_canonical_pair(left_value, top));
+               top = canonical_pair_hash(left_value, top);
             }
 
             // move up a level in the tree
@@ -133,10 +168,10 @@ namespace eosio {
          }
 
          // append the top of the collapsed tree (aka the root of the merkle)
-         updated_active_nodes.emplace_back(top);
+         updated_active_nodes[updated_count++] = top;
 
-         // store the new active_nodes
-         detail::move_nodes(_active_nodes, std::move(updated_active_nodes));
+         // store the new active_nodes, reusing the capacity of _active_nodes
+         _active_nodes.assign(updated_active_nodes, updated_active_nodes + updated_count);
 
          // update the node count
          _node_count++;
@@ -164,7 +199,7 @@ namespace eosio {
    /**
     * Very important function!
     */
-   void assert_inc_merkle_valid( const incremental_merkle& inc_mkl ){
+   inline void assert_inc_merkle_valid( const incremental_merkle& inc_mkl ){
       eosio_assert( inc_mkl._node_count != 0 && inc_mkl._active_nodes.size() != 0, "**");
 
       if ( inc_mkl._active_nodes.size() == 1 ){
@@ -183,15 +218,15 @@ namespace eosio {
             if ( is_equal_capi_checksum256( top, digest_type()) ){  // the first active node
                const auto& left_value = *active_iter;
                ++active_iter;
-               top = sha256hash(make_canonical_pair(left_value, left_value));
+               top = canonical_pair_hash(left_value, left_value);
             } else {
-               top = sha256hash(make_canonical_pair(top, top));
+               top = canonical_pair_hash(top, top);
             }
          } else { // right
             if ( ! is_equal_capi_checksum256( top, digest_type())){
                const auto& left_value = *active_iter;
                ++active_iter;
-               top = sha256hash(make_canonical_pair(left_value, top));
+               top = canonical_pair_hash(left_value, top);
             }
          }
 
@@ -203,7 +238,7 @@ namespace eosio {
       eosio_assert(is_equal_capi_checksum256(top, inc_mkl.get_root()), "**");
    }
 
-   digest_type get_inc_merkle_node_by_layer( const incremental_merkle& inc_mkl, const uint32_t& layer ) {
+   inline digest_type get_inc_merkle_node_by_layer( const incremental_merkle& inc_mkl, const uint32_t& layer ) {
       eosio_assert( inc_mkl._node_count != 0 && inc_mkl._active_nodes.size() != 0, "**");
 
       auto max_depth = detail::calcluate_max_depth( inc_mkl._node_count );
@@ -243,5 +278,43 @@ namespace eosio {
       return digest_type();
    }
 
+   /**
+    * All nodes get_inc_merkle_node_by_layer() can return, in ascending layer order.
+    * Returns a mask whose bit n - 1 is set when layer n has a node.
+    */
+   inline uint64_t get_inc_merkle_layer_nodes( const incremental_merkle& inc_mkl, std::vector<digest_type>& nodes ) {
+      nodes.clear();
+      if ( inc_mkl._node_count == 0 || inc_mkl._active_nodes.size() == 0 ){
+         return 0;
+      }
+
+      auto max_depth = detail::calcluate_max_depth( inc_mkl._node_count );
+      eosio_assert( max_depth <= detail::max_merkle_depth, "**");
+
+      uint64_t layers = 0;
+      auto index = inc_mkl._node_count;
+      auto active_iter = inc_mkl._active_nodes.begin();
+      for ( int layer = 1; layer < max_depth && active_iter != inc_mkl._active_nodes.end(); ++layer ){
+         if (index & 0x1) { // left
+            nodes.push_back( *active_iter );
+            layers |= uint64_t(1) << (layer - 1);
+            ++active_iter;
+         }
+         index = index >> 1;
+      }
+      nodes.push_back( inc_mkl._active_nodes.back() );
+      return layers | uint64_t(1) << (max_depth - 1);
+   }
+
+   /**
+    * Node of layer from the output of get_inc_merkle_layer_nodes(), asserts like get_inc_merkle_node_by_layer()
+    */
+   inline const digest_type& get_layer_node( uint64_t layers, const std::vector<digest_type>& nodes, uint32_t layer ) {
+      eosio_assert( 1 <= layer && layer <= 64 && (layers >> (layer - 1) & 0x1), "**");
+      auto index = detail::count_ones( layers & ((uint64_t(1) << (layer - 1)) - 1) );
+      eosio_assert( index < nodes.size(), "**");
+      return nodes[index];
+   }
+
 } /// eosio
 
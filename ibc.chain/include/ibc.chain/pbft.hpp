@@ -26,33 +26,70 @@ namespace eosio {
       EOSLIB_SERIALIZE(block_info_type, (block_id))
    };
 
+   // packed sizes used by get_checksum256 to hash pbft messages from a stack buffer
+   template<> struct fixed_pack_size<pbft_message_common> : std::integral_constant<size_t, 16> {};
+   template<> struct fixed_pack_size<block_info_type>     : std::integral_constant<size_t, 32> {};
+
+   // the signatures a pbft message or message group carries, all of them sign one digest
+   struct signature_range {
+      const signature_type*   first;
+      const signature_type*   last;
+
+      const signature_type*   begin()const { return first; }
+      const signature_type*   end()const { return last; }
+      size_t                  size()const { return last - first; }
+   };
+
    struct pbft_commit {
       pbft_message_common  common;
       uint32_t             view;
       block_info_type      block_info;
       signature_type       sender_signature;
 
-      digest_type digest( chain_id_type chain_id ) const {
+      digest_type digest( const chain_id_type& chain_id ) const {
          return get_checksum256( chain_id, common, view, block_info );
       }
 
-      block_id_type  block_id(){ return block_info.block_id; }
-      uint32_t       block_num(){ return block_header::num_from_id(block_info.block_id); }
+      const block_id_type& block_id()const { return block_info.block_id; }
+      uint32_t             block_num()const { return block_header::num_from_id(block_info.block_id); }
+      signature_range      signatures()const { return { &sender_signature, &sender_signature + 1 }; }
 
       EOSLIB_SERIALIZE(pbft_commit,  (common)(view)(block_info)(sender_signature))
    };
 
+   /**
+    * Commits that differ only in sender_signature, sent as their shared fields and a list of signatures,
+    * each signature is the one a pbft_commit with these fields would carry.
+    */
+   struct pbft_commit_group {
+      pbft_message_common           common;
+      uint32_t                      view;
+      block_info_type               block_info;
+      std::vector<signature_type>   sender_signatures;
+
+      digest_type digest( const chain_id_type& chain_id ) const {
+         return get_checksum256( chain_id, common, view, block_info );
+      }
+
+      const block_id_type& block_id()const { return block_info.block_id; }
+      uint32_t             block_num()const { return block_header::num_from_id(block_info.block_id); }
+      signature_range      signatures()const { return { sender_signatures.data(), sender_signatures.data() + sender_signatures.size() }; }
+
+      EOSLIB_SERIALIZE(pbft_commit_group, (common)(view)(block_info)(sender_signatures))
+   };
+
    struct pbft_checkpoint {
       pbft_message_common common;
       block_info_type     block_info;
       signature_type      sender_signature;
 
-      digest_type digest( chain_id_type chain_id ) const {
+      digest_type digest( const chain_id_type& chain_id ) const {
          return get_checksum256( chain_id, common, block_info );
       }
 
-      block_id_type  block_id(){ return block_info.block_id; }
-      uint32_t       block_num(){ return block_header::num_from_id(block_info.block_id); }
+      const block_id_type& block_id()const { return block_info.block_id; }
+      uint32_t             block_num()const { return block_header::num_from_id(block_info.block_id); }
+      signature_range      signatures()const { return { &sender_signature, &sender_signature + 1 }; }
 
       EOSLIB_SERIALIZE(pbft_checkpoint, (common)(block_info)(sender_signature))
    };
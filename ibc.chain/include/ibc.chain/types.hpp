@@ -5,6 +5,8 @@
 #pragma once
 
 #include <string>
+#include <type_traits>
+#include <eosiolib/datastream.hpp>
 #include <eosiolib/varint.hpp>
 #include <eosiolib/privileged.hpp>
 
@@ -22,27 +24,93 @@ namespace eosio {
    void push(T&){}
 
    template<typename Stream, typename T, typename ... Types>
-   void push(Stream &s, T arg, Types ... args){
+   void push(Stream &s, const T& arg, const Types& ... args){
       s << arg;
       push(s, args...);
    }
 
-   template<class ... Types> capi_checksum256 get_checksum256(const Types & ... args ){
-      datastream <size_t> ps;
-      push(ps, args...);
-      size_t size = ps.tellp();
+   /**
+    * Packed size of T when it is known at compile time, 0 for variable size types.
+    * Structs with a fixed layout declare their size by a specialization next to their definition.
+    */
+   template<typename T, typename Enable = void>
+   struct fixed_pack_size : std::integral_constant<size_t, 0> {};
+
+   template<typename T>
+   struct fixed_pack_size<T, std::enable_if_t<std::is_arithmetic<T>::value || std::is_enum<T>::value>>
+      : std::integral_constant<size_t, sizeof(T)> {};
+
+   template<> struct fixed_pack_size<capi_checksum256> : std::integral_constant<size_t, 32> {};
+   template<> struct fixed_pack_size<capi_public_key>  : std::integral_constant<size_t, 34> {};
+   template<> struct fixed_pack_size<capi_signature>   : std::integral_constant<size_t, 66> {};
+   template<> struct fixed_pack_size<name>             : std::integral_constant<size_t, 8> {};
+
+   template<typename A, typename B>
+   struct fixed_pack_size<std::pair<A,B>> : std::integral_constant<size_t,
+      fixed_pack_size<A>::value != 0 && fixed_pack_size<B>::value != 0 ? fixed_pack_size<A>::value + fixed_pack_size<B>::value : 0> {};
+
+   template<class ... Types>
+   constexpr size_t fixed_pack_size_of(){
+      return ( (fixed_pack_size<Types>::value != 0) && ... ) ? ( 0 + ... + fixed_pack_size<Types>::value ) : 0;
+   }
+
+   inline size_t varint_pack_size( uint32_t v ){
+      size_t n = 1;
+      while ( v >>= 7 ) ++n;
+      return n;
+   }
+
+   // packed size computed without a serialization pass where possible
+   template<typename T>
+   size_t packed_size( const T& v ){
+      if constexpr ( fixed_pack_size<T>::value != 0 ){
+         return fixed_pack_size<T>::value;
+      } else {
+         return pack_size( v );
+      }
+   }
+
+   template<typename T>
+   size_t packed_size( const std::vector<T>& v ){
+      if constexpr ( fixed_pack_size<T>::value != 0 ){
+         return varint_pack_size( v.size() ) + v.size() * fixed_pack_size<T>::value;
+      } else {
+         return pack_size( v );
+      }
+   }
 
-      std::vector<char> result;
-      result.resize(size);
+   inline size_t packed_size( const unsigned_int& v ){
+      return varint_pack_size( v.value );
+   }
 
-      datastream<char *> ds(result.data(), result.size());
-      push(ds, args...);
+   template<class ... Types> capi_checksum256 get_checksum256(const Types & ... args ){
       capi_checksum256 digest;
-      sha256(result.data(), result.size(), &digest);
+      constexpr size_t fixed_size = fixed_pack_size_of<Types...>();
+
+      if constexpr ( fixed_size != 0 ){
+         // all arguments have a fixed packed size, serialize into a stack buffer
+         char buf[fixed_size];
+         datastream<char*> ds( buf, fixed_size );
+         push(ds, args...);
+         eosio_assert( ds.tellp() == fixed_size, "get_checksum256: fixed_pack_size not consistent with serialization" );
+         sha256(buf, fixed_size, &digest);
+      } else {
+         // allocate once and serialize once
+         size_t size = ( packed_size(args) + ... );
+         std::vector<char> result( size );
+         datastream<char*> ds( result.data(), result.size() );
+         push(ds, args...);
+         eosio_assert( ds.tellp() == size, "get_checksum256: packed_size not consistent with serialization" );
+         sha256(result.data(), result.size(), &digest);
+      }
       return digest;
    }
 
    inline bool is_equal_capi_checksum256( capi_checksum256 a, capi_checksum256 b ){
       return std::memcmp( a.hash, b.hash, 32 ) == 0;
    }
+
+   inline bool is_less_capi_public_key( const capi_public_key& a, const capi_public_key& b ){
+      return std::memcmp( a.data, b.data, sizeof(capi_public_key) ) < 0;
+   }
 }
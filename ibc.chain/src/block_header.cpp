@@ -42,19 +42,35 @@ namespace eosio {
       return endian_reverse_u32(*(uint64_t*)(id.hash));
    }
 
-   block_id_type block_header::id()const
+   block_id_type block_header::id_from_digest(const capi_checksum256& digest, uint32_t block_num)
    {
       union {
          block_id_type result;
          uint64_t hash64[4];
       }u;
 
-      u.result = digest();
+      u.result = digest;
       u.hash64[0] &= 0xffffffff00000000;
-      u.hash64[0] += endian_reverse_u32(block_num());
+      u.hash64[0] += endian_reverse_u32(block_num);
       return u.result;
    }
 
+   block_id_type block_header::id()const
+   {
+      return id_from_digest( digest(), block_num() );
+   }
+
+   /**
+    * Digest of a header received packed. For a canonically packed header it equals digest() of the unpacked header
+    * without packing it again, any other encoding gives an id which can not match a signature or a merkle path.
+    */
+   digest_type block_header::digest_of_packed(const std::vector<char>& packed_header)
+   {
+      ::capi_checksum256 hash;
+      ::sha256( packed_header.data(), packed_header.size(), &hash );
+      return hash;
+   }
+
    std::optional<eosio::producer_schedule> block_header::get_ext_new_producers( uint16_t new_prd_ext_id ) const {
       for ( auto ext : header_extensions ){
          if ( std::get<0>(ext) == new_prd_ext_id ){
@@ -73,4 +89,85 @@ namespace eosio {
       return std::optional<eosio::producer_schedule>();
    }
 
-} /// namespace eosio
\ No newline at end of file
+   // ------ signed_block_header_view ------ //
+
+   digest_type signed_block_header_view::digest()const
+   {
+      if ( ! _digest ){
+         // the packed block_header is the packed signed_block_header without its trailing signature
+         _digest.emplace();
+         ::sha256( begin, size - sizeof(capi_signature), &*_digest );
+      }
+      return *_digest;
+   }
+
+   block_id_type signed_block_header_view::id()const
+   {
+      return block_header::id_from_digest( digest(), block_num() );
+   }
+
+   signed_block_header signed_block_header_view::get_header()const
+   {
+      return unpack<signed_block_header>( begin, size );
+   }
+
+   inline void skip_header_bytes( datastream<const char*>& ds, size_t n )
+   {
+      eosio_assert( ds.remaining() >= n, "invalid headers data" );
+      ds.skip( n );
+   }
+
+   signed_block_header_view get_header_view( datastream<const char*>& ds )
+   {
+      signed_block_header_view v;
+      v.begin = ds.pos();
+
+      ds >> v.timestamp >> v.producer >> v.confirmed >> v.previous;
+      skip_header_bytes( ds, 2 * sizeof(capi_checksum256) );         // transaction_mroot, action_mroot
+      ds >> v.schedule_version;
+
+      ds >> v.has_new_producers;
+      if ( v.has_new_producers ){
+         skip_header_bytes( ds, sizeof(uint32_t) );                  // version
+         unsigned_int producers;
+         ds >> producers;
+         for ( uint32_t j = 0; j < producers.value; ++j ){
+            skip_header_bytes( ds, sizeof(uint64_t) );               // producer_name
+            unsigned_int key_type;
+            ds >> key_type;
+            skip_header_bytes( ds, 33 );                             // block_signing_key data
+         }
+      }
+
+      unsigned_int extensions;
+      ds >> extensions;
+      for ( uint32_t j = 0; j < extensions.value; ++j ){
+         skip_header_bytes( ds, sizeof(uint16_t) );
+         unsigned_int ext_size;
+         ds >> ext_size;
+         skip_header_bytes( ds, ext_size.value );
+      }
+
+      skip_header_bytes( ds, sizeof(capi_signature) );               // producer_signature
+      v.size = ds.pos() - v.begin;
+      return v;
+   }
+
+   std::vector<signed_block_header_view> get_header_views( const std::vector<char>& headers_data )
+   {
+      const static size_t min_header_size = 182;   // signed_block_header without new_producers and header_extensions
+
+      datastream<const char*> ds( headers_data.data(), headers_data.size() );
+      unsigned_int count;
+      ds >> count;
+      eosio_assert( count.value <= ds.remaining() / min_header_size, "invalid headers data" );
+
+      std::vector<signed_block_header_view> views;
+      views.reserve( count.value );
+      for ( uint32_t i = 0; i < count.value; ++i ){
+         views.push_back( get_header_view( ds ) );
+      }
+      return views;
+   }
+
+} /// namespace eosio
@@ -9,27 +9,70 @@
 
 namespace eosio {
 
+   /**
+    * The first argument of every action but setadmin, the peer chain whose light client the action works on.
+    * The tables are scoped by it before the action is dispatched, so the actions take chain_name only to have it
+    * in their ABI and check it with check_chain_name(). setadmin uses the admin table of scope _self alone.
+    */
+   static name read_chain_name( datastream<const char*> ds ){
+      name chain_name;
+      ds.seekp( 0 );
+      if ( ds.remaining() >= sizeof(uint64_t) ){
+         ds >> chain_name;
+      }
+      return chain_name;
+   }
+
+   // writes value unless it is the row already stored, or the default value of a missing row
+   template<typename Singleton, typename T>
+   static void set_if_changed( Singleton& sg, const T& value, name payer ){
+      auto stored = sg.exists() ? pack( sg.get() ) : pack( T{} );
+      if ( pack( value ) != stored ){
+         sg.set( value, payer );
+      }
+   }
+
    chain::chain( name s, name code, datastream<const char*> ds ) :contract(s,code,ds),
-            _global_state(_self, _self.value),
+            _chain_name(read_chain_name(ds)),
+            _global_state(_self, _chain_name.value),
+            _global_mutable(_self, _chain_name.value),
+            _gc_sg(_self, _chain_name.value),
+            _reset_sg(_self, _chain_name.value),
+            _turn_sg(_self, _chain_name.value),
+            _mmr_sg(_self, _chain_name.value),
             _admin_sg(_self, _self.value),
-            _wtmsig_sg(_self, _self.value),
-            _global_mutable(_self, _self.value),
-            _chaindb(_self, _self.value),
-            _prodsches(_self, _self.value),
-            _sections(_self, _self.value),
-            _relays(_self, _self.value)
+            _wtmsig_sg(_self, _chain_name.value),
+            _chaindb(_self, _chain_name.value),
+            _forkdb(_self, _chain_name.value),
+            _anchors(_self, _chain_name.value),
+            _prodsches(_self, _chain_name.value),
+            _sections(_self, _chain_name.value),
+            _relays(_self, _chain_name.value)
    {
       _gstate = _global_state.exists() ? _global_state.get() : global_state{};
       _gmutable = _global_mutable.exists() ? _global_mutable.get() : global_mutable{};
+      _gc_st = _gc_sg.exists() ? _gc_sg.get() : gc_state{};
+      _reset_st = _reset_sg.exists() ? _reset_sg.get() : reset_state{};
+      _turn_st = _turn_sg.exists() ? _turn_sg.get() : relay_turn{};
+      _mmr_st = _mmr_sg.exists() ? _mmr_sg.get() : anchor_mmr{};
       _admin_st = _admin_sg.exists() ? _admin_sg.get() : admin_struct{};
       _wtmsig_st = _wtmsig_sg.exists() ? _wtmsig_sg.get() : wtmsig_struct{};
    }
 
    chain::~chain() {
-      _global_state.set( _gstate, _self );
-      _global_mutable.set( _gmutable, _self );
-      _admin_sg.set( _admin_st , _self );
-      _wtmsig_sg.set( _wtmsig_st , _self );
+      set_if_changed( _global_state, _gstate, _self );
+      set_if_changed( _global_mutable, _gmutable, _self );
+      set_if_changed( _gc_sg, _gc_st, _self );
+      set_if_changed( _reset_sg, _reset_st, _self );
+      set_if_changed( _turn_sg, _turn_st, _self );
+      set_if_changed( _mmr_sg, _mmr_st, _self );
+      set_if_changed( _admin_sg, _admin_st, _self );
+      set_if_changed( _wtmsig_sg, _wtmsig_st, _self );
+   }
+
+   void chain::check_chain_name( const name& chain_name ){
+      eosio_assert( chain_name == _chain_name, "chain_name must be the first argument of the action");
+      eosio_assert( _global_state.exists(), "chain_name not initialized, call setglobal first");
    }
 
    void chain::setglobal( name              chain_name,
@@ -38,7 +81,8 @@ namespace eosio {
                           bool              wtmsig_activated,
                           uint32_t          wtmsig_ext_id  ){
       require_auth( _self );
-      eosio_assert( chain_name != ""_n, "chain_name can not be empty");
+      eosio_assert( chain_name != name(), "chain_name can not be empty");
+      eosio_assert( chain_name == _chain_name, "chain_name must be the first argument of the action");
       eosio_assert( ! is_equal_capi_checksum256(chain_id, chain_id_type()), "chain_id can not be empty");
       eosio_assert( consensus_algo == "pipeline"_n || consensus_algo == "batch"_n, "consensus_algo must be pipeline or batch" );
       _gstate.chain_name      = chain_name;
@@ -54,31 +98,52 @@ namespace eosio {
       _admin_st.admin = admin;
    }
 
+   void chain::setgc( const name& chain_name, uint32_t row_budget ){
+      check_chain_name( chain_name );
+      check_admin_auth();
+      eosio_assert( row_budget > 0, "row_budget must be positive");
+      _gc_st.row_budget = row_budget;
+   }
+
+   void chain::setturns( const name& chain_name, uint32_t turn_length, uint32_t takeover_timeout ){
+      check_chain_name( chain_name );
+      check_admin_auth();
+      eosio_assert( turn_length == 0 || takeover_timeout < turn_length, "takeover_timeout must be less than turn_length");
+      _turn_st.turn_length = turn_length;
+      _turn_st.takeover_timeout = takeover_timeout;
+      _turn_st.served_turn = 0;
+   }
+
+   void chain::take_relay_turn( const name& relay ){
+      if ( require_relay_turn( _self, _chain_name, relay ) ){
+         serve_relay_turn();
+      }
+   }
+
+   // the current turn is served by its relay, no other relay may take it over
+   void chain::serve_relay_turn(){
+      _turn_st.served_turn = now() / _turn_st.turn_length;
+   }
+
    // init for both pipeline and batch light client
-   void chain::chaininit( const std::vector<char>&      header_data,
+   void chain::chaininit( const name&                   chain_name,
+                          const std::vector<char>&      header_data,
                           const producer_schedule&      active_schedule,
                           const incremental_merkle&     blockroot_merkle,
                           const name&                   relay ) {
-      if ( has_auth(_self) ){
-         while ( _chaindb.begin() != _chaindb.end() ){ _chaindb.erase(_chaindb.begin()); }
-         while ( _prodsches.begin() != _prodsches.end() ){ _prodsches.erase(_prodsches.begin()); }
-         while ( _sections.begin() != _sections.end() ){ _sections.erase(_sections.begin()); }
-         _gmutable = global_mutable{};
-      } else {
-         eosio_assert( _chaindb.begin() == _chaindb.end() &&
-                       _prodsches.begin() == _prodsches.end() &&
-                       _sections.begin() == _sections.end() &&
-                       _gmutable.last_anchor_block_num == 0, "the light client has already been initialized" );
-         require_relay_auth( _self, relay );
-      }
+      check_chain_name( chain_name );
+      if ( ! prepare_init( relay ) ){ return; }
 
-      const signed_block_header& header = unpack<signed_block_header>( header_data );
+      datastream<const char*> ds( header_data.data(), header_data.size() );
+      auto header_view = get_header_view( ds );
+      const signed_block_header& header = header_view.get_header();
 
       auto active_schedule_id = 1;
       _prodsches.emplace( _self, [&]( auto& r ) {
          r.id              = active_schedule_id;
          r.schedule        = active_schedule;
          r.schedule_hash   = get_schedule_hash( active_schedule );
+         r.build_producer_index();
       });
 
       auto block_signing_key = get_public_key_by_producer( active_schedule_id, header.producer );
@@ -86,7 +151,7 @@ namespace eosio {
 
       block_header_state bhs;
       bhs.block_num             = header_block_num;
-      bhs.block_id              = header.id();
+      bhs.block_id              = header_view.id();
       bhs.header                = header;
 
       /** In this function, block_header_state's pending_schedule version must equal to active_schedule version
@@ -97,9 +162,10 @@ namespace eosio {
       bhs.block_signing_key     = block_signing_key;
       bhs.is_anchor_block       = true;
 
-      auto dg = bhs_sig_digest( bhs );
+      auto dg = bhs_sig_digest( bhs, header_view.digest() );
       assert_producer_signature( dg, header.producer_signature, block_signing_key );
 
+      store_anchor( bhs, true );
       _chaindb.emplace( _self, [&]( auto& r ) {
          r = std::move( bhs );
       });
@@ -117,57 +183,272 @@ namespace eosio {
       _sections.emplace( _self, [&]( auto& r ) {
          r = std::move( sct );
       });
+
+      _gc_st.cursor = header_block_num;
+   }
+
+   /**
+    * Checks the auth of an init action and resets the light client first if needed, see chaininit in README.md.
+    * Returns false if the reset is not finished, the caller must return without initializing then.
+    */
+   bool chain::prepare_init( const name& relay ){
+      if ( has_auth(_self) || _reset_st.stage != name() ){
+         if ( ! has_auth(_self) ){
+            require_relay_auth( _self, _chain_name, relay );
+         }
+         if ( ! reset_light_client() ){
+            print_f("reset in progress, % rows erased, please call the init action again", _reset_st.rows_erased);
+            return false;
+         }
+      } else {
+         eosio_assert( _chaindb.begin() == _chaindb.end() &&
+                       _prodsches.begin() == _prodsches.end() &&
+                       _sections.begin() == _sections.end() &&
+                       _gmutable.last_anchor_block_num == 0, "the light client has already been initialized" );
+         require_relay_auth( _self, _chain_name, relay );
+      }
+      return true;
+   }
+
+   void chain::checkpoint( const name& chain_name, const name& relay ){
+      check_chain_name( chain_name );
+      require_relay_auth( _self, _chain_name, relay );
+      eosio_assert( _reset_st.stage == name(), "the light client is being reset");
+      eosio_assert( _anchors.begin() != _anchors.end(), "the light client has no anchor block");
+
+      auto anchor_block_num = (--_anchors.end())->block_num;
+      auto itr = _chaindb.find( anchor_block_num );
+      eosio_assert( itr != _chaindb.end(), "internal error, anchor block not found in chaindb");
+
+      light_client_checkpoint cp;
+      cp.chain_id          = _gstate.chain_id;
+      cp.consensus_algo    = _gstate.consensus_algo;
+      cp.anchor_header     = itr->header;
+      cp.active_schedule   = _prodsches.get( itr->active_schedule_id, "active schedule of the anchor block not found" ).schedule;
+      cp.pending_schedule  = _prodsches.get( itr->pending_schedule_id, "pending schedule of the anchor block not found" ).schedule;
+      cp.blockroot_merkle  = load_blockroot_merkle( itr );
+
+      auto sit = _sections.upper_bound( anchor_block_num );
+      eosio_assert( sit != _sections.begin(), "section of the anchor block not found");
+      --sit;
+      eosio_assert( sit->last >= anchor_block_num, "section of the anchor block not found");
+
+      // the section as it was at the anchor block: producers added after it are dropped, and the section is valid
+      // from there unless a producer replacement is still in progress
+      auto& s = cp.section;
+      s = *sit;
+      s.first = anchor_block_num;
+      s.last = anchor_block_num;
+      while ( s.producers_size > 0 && s.block_num_back() > anchor_block_num ){
+         --s.producers_size;
+      }
+      s.valid = _gstate.consensus_algo == "batch"_n || itr->active_schedule_id == itr->pending_schedule_id;
+      if ( s.valid ){
+         s.newprod_block_num = 0;
+      }
+      s.clear_confirmations();
+      s.proposed_lib_num = s.valid ? anchor_block_num : 0;
+
+      checkpoint_singleton( _self, _chain_name.value ).set( cp, _self );
+      print_f("-- checkpoint at anchor block % --", anchor_block_num);
+   }
+
+   void chain::bootstrap( const name&                      chain_name,
+                          const light_client_checkpoint&   cp,
+                          const name&                      relay ){
+      check_chain_name( chain_name );
+      if ( ! prepare_init( relay ) ){ return; }
+
+      eosio_assert( is_equal_capi_checksum256( cp.chain_id, _gstate.chain_id ), "chain_id of the checkpoint not match");
+      eosio_assert( cp.consensus_algo == _gstate.consensus_algo, "consensus_algo of the checkpoint not match");
+
+      const signed_block_header& header = cp.anchor_header;
+      auto header_block_num = header.block_num();
+      eosio_assert( header.schedule_version == cp.active_schedule.version, "schedule_version of the anchor header not match");
+
+      const auto& s = cp.section;
+      eosio_assert( s.first == header_block_num && s.last == header_block_num, "section of the checkpoint must begin and end at the anchor block");
+      eosio_assert( s.producers_size <= producer_history_length && s.producers_head < producer_history_length &&
+                    ( s.producers_size == 0 || ( s.producers.size() == producer_history_length &&
+                                                 s.block_nums.size() == producer_history_length )), "invalid producer history");
+      for ( uint32_t i = 0; i < s.producers_size; ++i ){
+         eosio_assert( s.block_num_back(i) <= header_block_num, "invalid producer history");
+      }
+
+      auto active_schedule_id = 1;
+      _prodsches.emplace( _self, [&]( auto& r ) {
+         r.id              = active_schedule_id;
+         r.schedule        = cp.active_schedule;
+         r.schedule_hash   = get_schedule_hash( cp.active_schedule );
+         r.build_producer_index();
+      });
+
+      auto pending_schedule_id = active_schedule_id;
+      auto pending_schedule_hash = get_schedule_hash( cp.pending_schedule );
+      if ( ! is_equal_capi_checksum256( pending_schedule_hash, _prodsches.get( active_schedule_id ).schedule_hash )){
+         eosio_assert( cp.pending_schedule.version == cp.active_schedule.version + 1, "pending_schedule version invalid");
+         eosio_assert( ! s.valid && s.newprod_block_num != 0 && s.newprod_block_num < header_block_num,
+                       "section of the checkpoint must be in a producer replacement");
+         pending_schedule_id = active_schedule_id + 1;
+         _prodsches.emplace( _self, [&]( auto& r ) {
+            r.id              = pending_schedule_id;
+            r.schedule        = cp.pending_schedule;
+            r.schedule_hash   = pending_schedule_hash;
+            r.build_producer_index();
+         });
+      } else {
+         eosio_assert( s.valid, "section of the checkpoint must be valid");
+      }
+
+      auto header_digest = header.digest();   // hashed once for both the block id and the signature digest
+
+      block_header_state bhs;
+      bhs.block_num             = header_block_num;
+      bhs.block_id              = block_header::id_from_digest( header_digest, header_block_num );
+      bhs.header                = header;
+      bhs.active_schedule_id    = active_schedule_id;
+      bhs.pending_schedule_id   = pending_schedule_id;
+      bhs.blockroot_merkle      = cp.blockroot_merkle;
+      bhs.block_signing_key     = get_public_key_by_producer( active_schedule_id, header.producer );
+      bhs.is_anchor_block       = true;
+
+      auto dg = bhs_sig_digest( bhs, header_digest );
+      assert_producer_signature( dg, header.producer_signature, bhs.block_signing_key );
+
+      store_anchor( bhs, true );
+      _chaindb.emplace( _self, [&]( auto& r ) {
+         r = std::move( bhs );
+      });
+
+      _sections.emplace( _self, [&]( auto& r ) {
+         r = s;
+         r.clear_confirmations();
+         r.proposed_lib_num = r.valid ? header_block_num : 0;
+         if ( r.producers_size == 0 ){
+            r.add( header.producer, header_block_num );
+         }
+      });
+
+      _gmutable.last_anchor_block_num = header_block_num;
+      _gc_st.cursor = header_block_num;
+      print_f("-- bootstrapped at anchor block % --", header_block_num);
    }
 
 
    // ------ section related functions ------ //
 
-   void chain::pushsection( const std::vector<char>&    headers_data,
+   uint64_t staged_key( uint32_t block_num, const block_id_type& block_id ){
+      return uint64_t(block_num) << 32 | uint64_t(block_id.hash[4]) << 24 | uint64_t(block_id.hash[5]) << 16 |
+             uint64_t(block_id.hash[6]) << 8 | uint64_t(block_id.hash[7]);
+   }
+
+   void chain::pushsection( const name&                 chain_name,
+                            const std::vector<char>&    headers_data,
                             const incremental_merkle&   blockroot_merkle,
                             const name&                 relay ) {
-      require_relay_auth( _self, relay );
+      check_chain_name( chain_name );
+      require_relay_auth( _self, _chain_name, relay );
+      bool own_turn = require_relay_turn( _self, _chain_name, relay );   // before any header is verified
 
       eosio_assert( _gstate.consensus_algo == "pipeline"_n, "consensus algorithm must be pipeline");
+      eosio_assert( _reset_st.stage == name(), "the light client is being reset");
 
-      std::vector<signed_block_header> headers = unpack<std::vector<signed_block_header>>( headers_data );
+      std::vector<signed_block_header_view> headers = get_header_views( headers_data );
+      eosio_assert( headers.size() > 0, "headers can not be empty");
       eosio_assert( _sections.begin() != _sections.end(), "the light client has not been initialized yet");
-      const auto& last_section = *(_sections.rbegin());
+      const auto& last_section = tip_section();
 
       uint32_t front_block_num = headers.front().block_num();
       eosio_assert ( front_block_num >= last_section.first, "front_block_num >= last_section.first must be true");
 
+      auto header_itr = headers.begin();
       bool create_section = false;
-      if ( front_block_num > last_section.last + 1 ) {      // create new section
+      if ( front_block_num > last_section.last + 1 &&                               // create new section, unless
+           ! is_staged_header( front_block_num - 1, headers.front().previous )) {    // it extends a staged branch
          eosio_assert( last_section.valid , "last section must be completed first");
          create_section = true;
       }
-      else if ( front_block_num == last_section.first ) {   // delete old and create new section
-         eosio_assert( ! is_equal_capi_checksum256(headers.front().id(), _chaindb.get( front_block_num ).block_id), "first block header repeated");
-         if ( ! remove_invalid_last_section()){ return; }
-         create_section = true;
+      else if ( front_block_num == last_section.first ) {
+         if ( is_stored_header( front_block_num, headers.front().id() ) ){   // pushed again, e.g. by another relay
+            ++header_itr;
+         } else {                                           // delete old and create new section
+            if ( ! remove_invalid_last_section()){
+               if ( own_turn ){ serve_relay_turn(); }
+               return;
+            }
+            create_section = true;
+         }
       }
 
       if ( create_section ){
          eosio_assert( headers.size() >= 30, "new section's size must not less then 30");
-         new_section( headers.front(), blockroot_merkle );
-         headers.erase( headers.begin() );
+         new_section( *header_itr, blockroot_merkle );
+         ++header_itr;
       }
 
-      for ( const auto & header : headers ){
-         append_header( header );
+      for ( ; header_itr != headers.end(); ++header_itr ){
+         append_header( *header_itr );
       }
+      flush_tip_section();
 
-      // mark anchor block
-      auto ls = *(_sections.rbegin());
-      if ( !ls.valid ){ return; }
-      uint32_t anchor_block_num = ls.last - lib_depth;
-      auto itr = _chaindb.find( anchor_block_num );
-      if ( itr != _chaindb.end() ){
+      // headers which are all stored already, e.g. pushed by another relay, do not serve a turn
+      if ( own_turn && _stored_headers > 0 ){ serve_relay_turn(); }
+
+      mark_anchor_block();
+      append_irreversible_anchors();
+      collect_garbage( headers.size() );
+   }
+
+   void chain::pushrounds( const name&                         chain_name,
+                           const std::vector<char>&            headers_data,
+                           const std::vector<block_id_type>&   skipped_ids,
+                           const name&                         relay ) {
+      check_chain_name( chain_name );
+      require_relay_auth( _self, _chain_name, relay );
+      bool own_turn = require_relay_turn( _self, _chain_name, relay );   // before any header is verified
+
+      eosio_assert( _gstate.consensus_algo == "pipeline"_n, "consensus algorithm must be pipeline");
+      eosio_assert( _reset_st.stage == name(), "the light client is being reset");
+
+      std::vector<signed_block_header_view> headers = get_header_views( headers_data );
+      eosio_assert( headers.size() > 0, "headers can not be empty");
+      eosio_assert( _sections.begin() != _sections.end(), "the light client has not been initialized yet");
+
+      auto skipped_itr = skipped_ids.begin();
+      for ( const auto& header : headers ){
+         append_round_header( header, skipped_itr, skipped_ids.end() );
+      }
+      eosio_assert( skipped_itr == skipped_ids.end(), "too many skipped_ids");
+      flush_tip_section();
+
+      if ( own_turn && _stored_headers > 0 ){ serve_relay_turn(); }
+
+      mark_anchor_block();
+      append_irreversible_anchors();
+      collect_garbage( headers.size() );
+   }
+
+   /// marks the newest irreversible header of the last section, the proposed LIB confirmed by 2/3+1 producers or lib_depth deep
+   void chain::mark_anchor_block(){
+      const auto& ls = tip_section();
+      if ( ! ls.valid ){ return; }
+
+      // pushrounds does not store every header, the newest stored one not after it is taken
+      uint64_t anchor_block_num = std::max<uint64_t>( ls.proposed_lib_num, ls.last > lib_depth ? ls.last - lib_depth : 0 );
+      auto itr = _chaindb.upper_bound( anchor_block_num );
+      if ( itr == _chaindb.begin() ){ return; }
+      --itr;
+      if ( itr->block_num < ls.first ){ return; }
+
+      if ( ! itr->is_anchor_block ){
+         auto blockroot_merkle = load_blockroot_merkle( itr );   // anchor blocks are snapshots
          _chaindb.modify( itr, same_payer, [&]( auto& r ) {
             r.is_anchor_block = true;
+            r.blockroot_merkle = std::move( blockroot_merkle );
          });
-         _gmutable.last_anchor_block_num = anchor_block_num;
+         store_anchor( *itr, false );
       }
+      _gmutable.last_anchor_block_num = itr->block_num;
    }
 
    /**
@@ -176,8 +457,10 @@ namespace eosio {
     * the header should not have new_producers and schedule_version consist with the last valid lwc section
     * the header block number should greater then the last block number of last section
     */
-   void chain::new_section( const signed_block_header& header,
-                           const incremental_merkle&  blockroot_merkle ){
+   void chain::new_section( const signed_block_header_view&  header_view,
+                            const incremental_merkle&        blockroot_merkle ){
+
+      const signed_block_header& header = header_view.get_header();
 
       auto new_producers = header.new_producers;
       if ( _wtmsig_st.activated ){
@@ -187,11 +470,11 @@ namespace eosio {
 
       auto header_block_num = header.block_num();
 
-      const auto& last_section = *(_sections.rbegin());
+      const auto& last_section = tip_section();
       eosio_assert( last_section.valid, "last_section is not valid" );
       eosio_assert( header_block_num > last_section.last + 1, "header_block_num should larger then last_section.last + 1" );
 
-      auto active_schedule_id = get_section_last_active_schedule_id( last_section );
+      auto active_schedule_id = get_tip( last_section.last ).active_schedule_id;
       auto version = _prodsches.get( active_schedule_id ).schedule.version;
       eosio_assert( header.schedule_version == version, "schedule_version not equal to previous one" );
 
@@ -199,17 +482,18 @@ namespace eosio {
 
       block_header_state bhs;
       bhs.block_num             = header_block_num;
-      bhs.block_id              = header.id();
+      bhs.block_id              = header_view.id();
       bhs.header                = header;
       bhs.active_schedule_id    = active_schedule_id;
       bhs.pending_schedule_id   = active_schedule_id;
       bhs.blockroot_merkle      = blockroot_merkle;
       bhs.block_signing_key     = block_signing_key;
 
-      auto dg = bhs_sig_digest( bhs );
+      auto dg = bhs_sig_digest( bhs, header_view.digest() );   // memoized, hashed once together with the block id
       assert_producer_signature( dg, header.producer_signature, block_signing_key );
 
       remove_header_if_exist( header_block_num );
+      _tip.set( bhs );
       _chaindb.emplace( _self, [&]( auto& r ) {
          r = std::move( bhs );
       });
@@ -223,6 +507,8 @@ namespace eosio {
       _sections.emplace( _self, [&]( auto& r ) {
          r = std::move( sct );
       });
+      reload_tip_section();
+      ++_stored_headers;
 
       print_f("-- new section block added: % --", header_block_num);
    }
@@ -251,36 +537,60 @@ namespace eosio {
     * 1. the header must be linkable to the last section
     * 2. can not push repeated block header
     */
-   void chain::append_header( const signed_block_header& header ) {
+   void chain::append_header( const signed_block_header_view& header ) {
       auto header_block_num = header.block_num();
-      auto header_block_id = header.id();
+      auto header_block_id = header.id();   // hashed over the pushed bytes, the digest is reused by bhs_sig_digest
 
-      const auto& last_section = *(_sections.rbegin());
+      const auto& last_section = tip_section();
       auto last_section_first = last_section.first;
       auto last_section_last = last_section.last;
       
       eosio_assert( header_block_num > last_section_first, "new header number must larger then section root number" );
-      eosio_assert( header_block_num <= last_section_last + 1, "unlinkable block" );
 
       // delete old branch
       if ( header_block_num < last_section_last + 1){
-         auto result = _chaindb.get( header_block_num );
-         eosio_assert( std::memcmp(header_block_id.hash, result.block_id.hash, 32) != 0, ("block repeated: " + std::to_string(header_block_num)).c_str() );
+         // already stored, e.g. pushed by another relay, skipped without verifying it again
+         if ( is_stored_header( header_block_num, header_block_id ) ){
+            return;
+         }
 
-         _sections.modify( last_section, same_payer, [&]( auto& r ) {
-            r.valid = header_block_num - last_section_first < lib_depth ? false : last_section.valid;
-            r.clear_from( header_block_num );
-         });
+         // kept apart until its branch is irreversible
+         if ( stage_header( header, header_block_id ) ){
+            promote_branch( header_block_id );
+            return;
+         }
+
+         // the parent must be stored, not skipped by pushrounds nor before the first header of the section
+         eosio_assert( _chaindb.find( header_block_num ) != _chaindb.end() &&
+                       _chaindb.find( header_block_num - 1 ) != _chaindb.end(), "fork point is too old" );
+         // the proposed LIB is taken as final, nodeos itself rejects only forks before its final LIB
+         eosio_assert( header_block_num > last_section.proposed_lib_num, "can not fork before an irreversible block" );
+
+         auto& s = modify_tip_section();
+         s.valid = header_block_num - last_section_first < lib_depth && s.proposed_lib_num < last_section_first ? false : s.valid;
+         s.clear_from( header_block_num );
 
          while ( _chaindb.rbegin()->block_num != header_block_num - 1 ){
-            _chaindb.erase( --_chaindb.end() );
+            erase_header( --_chaindb.end() );
          }
 
          print_f("-- block deleted: from % back to % --", last_section_last, header_block_num);
       }
 
+      // extends a staged branch beyond the last stored header
+      else if ( header_block_num > last_section_last + 1 || ! is_stored_header( header_block_num - 1, header.previous ) ){
+         if ( stage_header( header, header_block_id ) ){
+            promote_branch( header_block_id );
+            return;
+         }
+         // a header starting a producers replacement can not be staged, its branch is the one the chain goes on with
+         eosio_assert( header.has_new_producers ||
+                       ( _wtmsig_st.activated && header.get_header().get_ext_new_producers( _wtmsig_st.ext_id )), "unlinkable block" );
+         promote_branch( header.previous, true );
+      }
+
       // verify linkable
-      auto last_bhs = _chaindb.get( header_block_num - 1 );   // don't make pointer or const, for it needs change
+      auto& last_bhs = get_tip( header_block_num - 1 );   // replaced by this header at the end, its merkle can be moved
       eosio_assert(std::memcmp(last_bhs.block_id.hash, header.previous.hash, 32) == 0 , "unlinkable block" );
 
       // verify new block
@@ -294,23 +604,7 @@ namespace eosio {
       // handle bps list replacement
       if ( last_bhs.active_schedule_id == last_bhs.pending_schedule_id ){  // normal circumstances
 
-         // check if last_section valid
-         bool valid = false;
-         if ( last_section.newprod_block_num != 0 ){
-            if ( header_block_num - last_section.newprod_block_num >= lib_depth * 2 ){
-               valid = true;
-            }
-         } else {
-            if ( header_block_num - last_section_first >= lib_depth ){
-               valid = true;
-            }
-         }
-
-         if ( valid && ! last_section.valid ){
-            _sections.modify( last_section, same_payer, [&]( auto& r ) {
-               r.valid = true;
-            });
-         }
+         update_section_valid( header_block_num );
 
          bhs.active_schedule_id  = last_bhs.active_schedule_id;
          bhs.pending_schedule_id = last_bhs.pending_schedule_id;
@@ -327,75 +621,377 @@ namespace eosio {
             // replace
             bhs.active_schedule_id  = last_bhs.pending_schedule_id;
 
-            // clear last_section's producers and block_nums
-            _sections.modify( last_section, same_payer, [&]( auto& s ) {
-               s.producers = std::vector<name>();
-               s.block_nums = std::vector<uint32_t>();
-            });
+            // clear last_section's producers and block_nums, confirmations are counted again under the new schedule,
+            // the section is not valid until a header from this one on is irreversible
+            auto& s = modify_tip_section();
+            s.clear_producers();
+            s.clear_confirmations();
+            s.proposed_lib_num = 0;
          } else { // producers replacement not finished
             bhs.active_schedule_id  = last_bhs.active_schedule_id;
          }
          bhs.pending_schedule_id = last_bhs.pending_schedule_id;
       }
 
-      auto new_producers = header.new_producers;
+      bhs.header = header.get_header();
+
+      auto new_producers = bhs.header.new_producers;
       if ( _wtmsig_st.activated ){
-         new_producers = header.get_ext_new_producers( _wtmsig_st.ext_id );
+         new_producers = bhs.header.get_ext_new_producers( _wtmsig_st.ext_id );
       }
 
       // handle new_producers
       if ( new_producers ){  // has new producers
          eosio_assert( new_producers->version == header.schedule_version + 1, "new_producers version invalid" );
 
-         _sections.modify( last_section, same_payer, [&]( auto& r ) {
-            r.valid = false;
-            r.newprod_block_num = header_block_num;
-         });
+         auto& s = modify_tip_section();
+         s.valid = false;
+         s.newprod_block_num = header_block_num;
 
          auto new_schedule_id = _prodsches.available_primary_key();
          _prodsches.emplace( _self, [&]( auto& r ) {
             r.id              = new_schedule_id;
             r.schedule        = *new_producers;
             r.schedule_hash   = get_schedule_hash( *new_producers );
+            r.build_producer_index();
          });
 
          if ( _prodsches.rbegin()->id - _prodsches.begin()->id >= prodsches_max_records ){
             _prodsches.erase( _prodsches.begin() );
+            _tip.active_schedule = nullptr;
          }
 
          bhs.pending_schedule_id = new_schedule_id;
       }
 
-      bhs.header = std::move(header);
-
-      if ( bhs.header.producer == last_bhs.header.producer && bhs.active_schedule_id == last_bhs.active_schedule_id ){
-         bhs.block_signing_key = std::move(last_bhs.block_signing_key);
+      if ( bhs.header.producer == last_bhs.producer && bhs.active_schedule_id == last_bhs.active_schedule_id ){
+         bhs.block_signing_key = last_bhs.block_signing_key;
       } else{
          bhs.block_signing_key = get_public_key_by_producer( bhs.active_schedule_id, bhs.header.producer );
       }
 
-      auto dg = bhs_sig_digest( bhs );
+      auto dg = bhs_sig_digest( bhs, header.digest() );
       assert_producer_signature( dg, bhs.header.producer_signature, bhs.block_signing_key);
 
+      store_header( bhs );
+
+      print_f("-- block added: % --", header_block_num);
+   }
+
+   /// checks if the last section becomes valid with a header under normal circumstances, no producers replacement
+   void chain::update_section_valid( uint32_t header_block_num ){
+      const auto& last_section = tip_section();
+      bool valid = false;
+      if ( last_section.newprod_block_num != 0 ){
+         if ( header_block_num - last_section.newprod_block_num >= lib_depth * 2 ){
+            valid = true;
+         }
+      } else {
+         if ( header_block_num - last_section.first >= lib_depth ){
+            valid = true;
+         }
+      }
+
+      if ( valid && ! last_section.valid ){
+         modify_tip_section().valid = true;
+      }
+   }
+
+   /// stores a verified header after the last one and adds it to the last section
+   void chain::store_header( block_header_state& bhs ){
+      auto header_block_num = bhs.block_num;
+      auto producer = bhs.header.producer;
+      auto slot = bhs.header.timestamp.slot;
+      auto confirmed = bhs.header.confirmed;
+
+      bool settled = bhs.active_schedule_id == bhs.pending_schedule_id;   // no producer replacement in progress
       remove_header_if_exist( header_block_num );
+      _tip.set( bhs );
+      if ( header_block_num % merkle_snapshot_interval != 0 ){
+         bhs.blockroot_merkle = incremental_merkle();
+      }
       _chaindb.emplace( _self, [&]( auto& r ) {
          r = std::move(bhs);
       });
+      ++_stored_headers;
 
-      const auto& active_schedule = _prodsches.get( bhs.active_schedule_id ).schedule;
+      const auto& active_schedule = tip_active_schedule();
 
-      _sections.modify( last_section, same_payer, [&]( auto& s ) {
-         s.last = header_block_num;
-         s.add( header.producer, header_block_num, header.timestamp.slot, active_schedule );
-      });
+      auto& s = modify_tip_section();
+      s.last = header_block_num;
+      s.add( producer, header_block_num, slot, active_schedule );
+
+      // a section is also valid once one of its headers after the last producer replacement is irreversible
+      s.confirm( producer, header_block_num, confirmed, active_schedule.schedule.producers.size() * 2 / 3 + 1 );
+      if ( settled && ! s.valid && s.proposed_lib_num >= s.first ){
+         s.valid = true;
+      }
 
       trim_last_section_or_not();
+   }
 
-      print_f("-- block added: % --", header_block_num);
+   /// adds a header of a staged branch to the section of that branch, as store_header() adds one to the last section
+   void add_to_branch( section_type& branch, const block_header_state& bhs, const producer_schedule_type& schedule ){
+      branch.last = bhs.block_num;
+      branch.add( bhs.header.producer, bhs.block_num, bhs.header.timestamp.slot, schedule );
+      branch.confirm( bhs.header.producer, bhs.block_num, bhs.header.confirmed, schedule.schedule.producers.size() * 2 / 3 + 1 );
+   }
+
+   /**
+    * Keeps a header competing with the stored branch in forkdb instead of replacing the stored headers after its fork point.
+    * The header is verified against its parent, the stored header before it or a staged one, its producer is checked by
+    * section_type::add() and its confirmations are counted on the section of its branch, and promote_branch() adds its
+    * branch to the last section once the branch is longer than the stored one or its first header is irreversible,
+    * i.e. not after the proposed LIB of the branch, which is taken as final.
+    * Returns false if it can not be staged: its branch forks too far back or is longer than fork_staging_depth + 1 headers,
+    * its parent is unknown, or under producers replacement.
+    */
+   bool chain::stage_header( const signed_block_header_view& header, const block_id_type& block_id ){
+      auto header_block_num = header.block_num();
+      if ( header.has_new_producers ){
+         return false;
+      }
+
+      auto key = staged_key( header_block_num, block_id );
+      auto existing = _forkdb.find( key );
+      if ( existing != _forkdb.end() ){   // staged already
+         eosio_assert( is_equal_capi_checksum256( existing->state.block_id, block_id ), "staging key collision" );
+         return true;
+      }
+
+      const auto& last_section = tip_section();
+      auto stored = _chaindb.find( header_block_num - 1 );
+      auto staged = _forkdb.end();
+      uint64_t fork_num = header_block_num;
+      if ( stored == _chaindb.end() || ! is_equal_capi_checksum256( stored->block_id, header.previous )){
+         staged = _forkdb.find( staged_key( header_block_num - 1, header.previous ));
+         if ( staged == _forkdb.end() || ! is_equal_capi_checksum256( staged->state.block_id, header.previous )){
+            return false;
+         }
+         fork_num = staged->fork_num;
+      }
+      // a branch forking at or before the proposed LIB, taken as final, can not win
+      if ( fork_num + fork_staging_depth <= last_section.last || fork_num <= last_section.proposed_lib_num ||
+           header_block_num - fork_num > fork_staging_depth ){
+         return false;
+      }
+
+      block_header_state parent;
+      section_type branch;
+      if ( staged == _forkdb.end() ){
+         parent = *stored;
+         parent.blockroot_merkle = load_blockroot_merkle( stored );
+         branch = last_section;
+         branch.clear_from( fork_num );
+      } else {
+         parent = staged->state;
+         branch = staged->branch;
+      }
+      const auto& schedule = _prodsches.get( parent.active_schedule_id );
+      if ( parent.active_schedule_id != parent.pending_schedule_id || header.schedule_version != schedule.schedule.version ){
+         return false;
+      }
+
+      block_header_state bhs;
+      bhs.block_num             = header_block_num;
+      bhs.block_id              = block_id;
+      bhs.header                = header.get_header();
+      if ( _wtmsig_st.activated && bhs.header.get_ext_new_producers( _wtmsig_st.ext_id )){
+         return false;
+      }
+      bhs.active_schedule_id    = parent.active_schedule_id;
+      bhs.pending_schedule_id   = parent.pending_schedule_id;
+      bhs.blockroot_merkle      = std::move( parent.blockroot_merkle );
+      bhs.blockroot_merkle.append( parent.block_id );
+      bhs.block_signing_key     = get_public_key_by_producer( bhs.active_schedule_id, bhs.header.producer );
+
+      auto dg = bhs_sig_digest( bhs, header.digest() );
+      assert_producer_signature( dg, bhs.header.producer_signature, bhs.block_signing_key );
+
+      add_to_branch( branch, bhs, schedule );
+
+      _forkdb.emplace( _self, [&]( auto& r ) {
+         r.key       = key;
+         r.state     = std::move( bhs );
+         r.fork_num  = fork_num;
+         r.branch    = std::move( branch );
+      });
+      ++_stored_headers;
+
+      print_f("-- block staged: % --", header_block_num);
+      return true;
    }
 
-   uint32_t chain::get_section_last_active_schedule_id( const section_type& section ) const {
-      return _chaindb.get( section.last ).active_schedule_id;
+   /**
+    * Replaces the stored headers after the fork point of the staged branch ending at block_id with that branch once
+    * it is longer than the stored one or its first header is irreversible, or at once if force is set.
+    * Irreversible means not after the proposed LIB of the branch, which is taken as final like in stage_header().
+    * The replaced headers are staged in turn, unless the branch is irreversible, so either branch can come back
+    * without its headers being pushed again.
+    */
+   void chain::promote_branch( const block_id_type& block_id, bool force ){
+      std::vector<forkdb::const_iterator> branch;   // in descending order
+      block_id_type id = block_id;
+      uint32_t num = block_header::num_from_id( id );
+      while ( true ){
+         auto staged = _forkdb.find( staged_key( num, id ));
+         eosio_assert( staged != _forkdb.end() && is_equal_capi_checksum256( staged->state.block_id, id ), "unlinkable block" );
+         if ( branch.empty() && ! force && staged->branch.proposed_lib_num < staged->fork_num &&
+              staged->state.block_num <= tip_section().last ){
+            return;
+         }
+         branch.push_back( staged );
+         id = staged->state.header.previous;
+         --num;
+         if ( is_stored_header( num, id ) ){ break; }
+      }
+
+      const auto& last_section = tip_section();
+      uint32_t fork_num = num + 1;
+      eosio_assert( fork_num > last_section.first, "fork point is too old" );
+      eosio_assert( fork_num > last_section.proposed_lib_num, "can not fork before an irreversible block" );
+
+      if ( branch.front()->branch.proposed_lib_num < fork_num ){
+         stage_stored_headers( fork_num );
+      }
+
+      auto& s = modify_tip_section();
+      s.valid = fork_num - s.first < lib_depth && s.proposed_lib_num < s.first ? false : s.valid;
+      s.clear_from( fork_num );
+      while ( _chaindb.rbegin()->block_num >= fork_num ){
+         erase_header( --_chaindb.end() );
+      }
+
+      for ( auto it = branch.rbegin(); it != branch.rend(); ++it ){
+         block_header_state bhs = (*it)->state;
+         _forkdb.erase( *it );
+         update_section_valid( bhs.block_num );
+         store_header( bhs );
+      }
+
+      print_f("-- branch promoted: from % to % --", fork_num, block_header::num_from_id( block_id ));
+   }
+
+   /**
+    * Stages the stored headers from fork_num on, about to be replaced by a longer branch, as stage_header() would have
+    * staged them. Nothing is staged if one of them is under producers replacement or the branch is too long.
+    */
+   void chain::stage_stored_headers( uint32_t fork_num ){
+      const auto& last_section = tip_section();
+      if ( last_section.last - fork_num > fork_staging_depth ){
+         return;
+      }
+      auto parent = _chaindb.find( fork_num - 1 );
+      for ( auto itr = std::next( parent ); itr != _chaindb.end(); ++itr ){
+         if ( itr->active_schedule_id != itr->pending_schedule_id || itr->header.new_producers ||
+              ( _wtmsig_st.activated && itr->header.get_ext_new_producers( _wtmsig_st.ext_id )) ){
+            return;
+         }
+      }
+
+      section_type branch = last_section;
+      branch.clear_from( fork_num );
+      auto blockroot_merkle = load_blockroot_merkle( parent );
+      auto parent_id = parent->block_id;
+      for ( auto itr = std::next( parent ); itr != _chaindb.end(); ++itr ){
+         block_header_state bhs = *itr;
+         blockroot_merkle.append( parent_id );
+         bhs.blockroot_merkle = blockroot_merkle;
+         parent_id = bhs.block_id;
+         add_to_branch( branch, bhs, _prodsches.get( bhs.active_schedule_id ));
+
+         auto key = staged_key( bhs.block_num, bhs.block_id );
+         if ( _forkdb.find( key ) != _forkdb.end() ){ continue; }
+         _forkdb.emplace( _self, [&]( auto& r ) {
+            r.key       = key;
+            r.state     = std::move( bhs );
+            r.fork_num  = fork_num;
+            r.branch    = branch;
+         });
+      }
+   }
+
+   /**
+    * Notes:
+    * 1. the header must be the first one of its producer's round after the last stored header, the block ids between them
+    *    are appended to the blockroot_merkle of the last stored header, and the header signature, which covers the resulting
+    *    blockroot_merkle, proves them
+    * 2. not under producers replacement, a header with new_producers or signed under a new pending schedule is rejected
+    * 3. stored headers keep the whole blockroot_merkle, the skipped ones are not stored
+    */
+   void chain::append_round_header( const signed_block_header_view& header,
+                                    std::vector<block_id_type>::const_iterator& skipped_itr,
+                                    std::vector<block_id_type>::const_iterator skipped_end ){
+      auto header_block_num = header.block_num();
+      auto header_block_id = header.id();
+
+      auto& last_bhs = get_tip();
+      if ( header_block_num <= last_bhs.block_num ){
+         // pushed again, e.g. by another relay
+         eosio_assert( is_stored_header( header_block_num, header_block_id ), "headers of pushrounds must extend the last section");
+         while ( skipped_itr != skipped_end && block_header::num_from_id( *skipped_itr ) < header_block_num ){ ++skipped_itr; }
+         return;
+      }
+
+      const auto& last_section = tip_section();
+      eosio_assert( last_section.last == last_bhs.block_num, "internal error: last section does not end at the last header");
+      eosio_assert( last_bhs.active_schedule_id == last_bhs.pending_schedule_id, "producers replacement in progress, use pushsection");
+      eosio_assert( header.producer != last_bhs.producer, "only the first header of a producer round can be pushed");
+
+      const auto& active_schedule = tip_active_schedule();
+      eosio_assert( header.schedule_version == active_schedule.schedule.version, "schedule_version not equal to previous one");
+
+      // link through the skipped blocks, the ids of already stored blocks are passed over
+      while ( skipped_itr != skipped_end && block_header::num_from_id( *skipped_itr ) <= last_bhs.block_num ){ ++skipped_itr; }
+      uint32_t skipped = header_block_num - last_bhs.block_num - 1;
+      eosio_assert( uint32_t( skipped_end - skipped_itr ) >= skipped, "not enough skipped_ids");
+
+      last_bhs.blockroot_merkle.append( last_bhs.block_id );
+      const block_id_type* previous = &last_bhs.block_id;
+      for ( uint32_t num = last_bhs.block_num + 1; num < header_block_num; ++num, ++skipped_itr ){
+         eosio_assert( block_header::num_from_id( *skipped_itr ) == num, "skipped_ids not continuous");
+         last_bhs.blockroot_merkle.append( *skipped_itr );
+         previous = &*skipped_itr;
+      }
+      eosio_assert( std::memcmp( previous->hash, header.previous.hash, 32 ) == 0, "unlinkable block" );
+
+      block_header_state bhs;
+      bhs.block_num             = header_block_num;
+      bhs.block_id              = std::move( header_block_id );
+      bhs.header                = header.get_header();
+      bhs.active_schedule_id    = last_bhs.active_schedule_id;
+      bhs.pending_schedule_id   = last_bhs.pending_schedule_id;
+      bhs.blockroot_merkle      = std::move( last_bhs.blockroot_merkle );
+      bhs.block_signing_key     = get_public_key_by_producer( bhs.active_schedule_id, bhs.header.producer );
+
+      auto new_producers = bhs.header.new_producers;
+      if ( _wtmsig_st.activated ){
+         new_producers = bhs.header.get_ext_new_producers( _wtmsig_st.ext_id );
+      }
+      eosio_assert( ! new_producers, "header with new_producers, use pushsection" );
+
+      auto dg = bhs_sig_digest( bhs, header.digest() );
+      assert_producer_signature( dg, bhs.header.producer_signature, bhs.block_signing_key );
+
+      _tip.set( bhs );
+      _chaindb.emplace( _self, [&]( auto& r ) {
+         r = std::move( bhs );
+      });
+      ++_stored_headers;
+
+      auto& s = modify_tip_section();
+      s.last = header_block_num;
+      s.add( header.producer, header_block_num, header.timestamp.slot, active_schedule );
+      s.confirm( header.producer, header_block_num, header.confirmed, active_schedule.schedule.producers.size() * 2 / 3 + 1, skipped );
+
+      bool valid = s.newprod_block_num != 0 ? header_block_num - s.newprod_block_num >= lib_depth * 2 : header_block_num - s.first >= lib_depth;
+      if ( ! s.valid && ( valid || s.proposed_lib_num >= s.first )){
+         s.valid = true;
+      }
+
+      trim_last_section_or_not();
+
+      print_f("-- round header added: %, % skipped --", header_block_num, skipped);
    }
 
    bool chain::remove_invalid_last_section( ){
@@ -408,7 +1004,7 @@ namespace eosio {
       for( uint64_t num = std::max(it->first, it->last - max_delete + 1); num <= it->last; ++num ){
          auto existing = _chaindb.find( num );
          if ( existing != _chaindb.end() ){
-            _chaindb.erase( existing );
+            erase_header( existing );
          }
       }
 
@@ -420,100 +1016,304 @@ namespace eosio {
             r.clear_from( it->last - max_delete + 1 );
          });
       }
+      reload_tip_section();
 
       return finished;
    }
 
+   /// compares against the tip first, so the last stored header pushed again costs no table lookup
+   bool chain::is_stored_header( uint32_t block_num, const block_id_type& block_id ){
+      if ( block_num == _tip.block_num ){
+         return is_equal_capi_checksum256( _tip.block_id, block_id );
+      }
+      auto itr = _chaindb.find( block_num );
+      return itr != _chaindb.end() && is_equal_capi_checksum256( itr->block_id, block_id );
+   }
+
+   bool chain::is_staged_header( uint32_t block_num, const block_id_type& block_id ){
+      auto itr = _forkdb.find( staged_key( block_num, block_id ));
+      return itr != _forkdb.end() && is_equal_capi_checksum256( itr->state.block_id, block_id );
+   }
+
    void chain::remove_header_if_exist( uint32_t block_num ){
       auto existing = _chaindb.find( block_num );
       if ( existing != _chaindb.end() ){
-         _chaindb.erase( existing );
+         erase_header( existing );
       }
    }
 
-   const static uint32_t max_trim = 50;
+   /**
+    * Every chaindb erasure goes through here to keep table anchors in step with is_anchor_block
+    */
+   chaindb::const_iterator chain::erase_header( chaindb::const_iterator itr ){
+      if ( itr->is_anchor_block ){
+         auto anchor = _anchors.find( itr->block_num );
+         if ( anchor != _anchors.end() ){
+            _anchors.erase( anchor );
+         }
+      }
+      if ( itr->block_num == _tip.block_num ){
+         _tip.block_num = 0;
+      }
+      return _chaindb.erase( itr );
+   }
 
-   void chain::trim_last_section_or_not() {
-      auto lwcls = *(_sections.rbegin());
-      if ( lwcls.last - lwcls.first > section_max_length ){
-
-         // delete blocks in _chaindb
-         for ( uint32_t num = lwcls.first; num < lwcls.first + max_trim; ++num ){
-            auto it = _chaindb.find( num );
-            if ( it != _chaindb.end() && !it->is_anchor_block ){
-               _chaindb.erase( it );
-            }
+   /**
+    * Erases rows which are no longer needed, continuing where the previous action stopped.
+    * It visits at most row_budget rows plus one per header pushed by this action, so that it keeps up with them:
+    * 1. sections before the one the light client may have to fall back to, which is the last section,
+    *    or the one before it while the last section is not valid yet;
+    * 2. all headers older than chaindb_max_history_length, anchor blocks included;
+    * 3. from the persisted cursor up to the first header of the last section, headers which are not anchor blocks and are
+    *    not needed by the section before it while it is kept: its first header, compared when the section is pushed again
+    *    from there, and its last lib_depth + 1 headers, which a fork can replace and of which the oldest becomes the next
+    *    anchor block. The last section keeps all its headers, so it can be pushed again from its first one, and
+    *    trim_last_section_or_not() bounds its length.
+    * Every visited row counts against the budget, skipped rows too.
+    * Whoever makes rows below the cursor unneeded, by erasing or trimming a section, moves the cursor back.
+    */
+   void chain::collect_garbage( uint32_t pushed_headers ){
+      uint32_t budget = _gc_st.row_budget + pushed_headers;
+
+      // starts at a blockroot_merkle snapshot, so that every header of the window can be loaded
+      auto window_first = []( const section_type& s ) -> uint64_t {
+         return s.last > s.first + lib_depth ? std::max( s.first, ( s.last - lib_depth ) / merkle_snapshot_interval * merkle_snapshot_interval ) : s.first;
+      };
+      auto last = _sections.rbegin();
+      auto fallback = last;
+      if ( ! last->valid && std::next( last ) != _sections.rend() ){ ++fallback; }
+      const uint64_t last_first = last->first;
+      const uint64_t keep_from = fallback->first, fallback_window = window_first( *fallback ), fallback_last = fallback->last;
+
+      // anchor blocks stored again by restoreanchor(), wherever they are
+      while ( budget > 0 && ! _gc_st.restored_anchors.empty() ){
+         auto anchor = _anchors.find( _gc_st.restored_anchors.back() );
+         if ( anchor != _anchors.end() ){
+            _anchors.erase( anchor );
          }
+         _gc_st.restored_anchors.pop_back();
+         --budget;
+      }
 
-         // construct new section info
-         section_type ls = lwcls;
-         ls.first += max_trim;
+      // staged headers which can no longer be promoted, their branch forks more than fork_staging_depth blocks behind the
+      // last header or not after the proposed LIB, taken as final. Rows are visited by block number, the oldest branch first,
+      // and the first one still promotable stops the pass, the rows after it are collected once it is
+      while ( budget > 0 && _forkdb.begin() != _forkdb.end() && ( _forkdb.begin()->fork_num + fork_staging_depth <= last->last ||
+                                                                  _forkdb.begin()->fork_num <= last->proposed_lib_num )){
+         _forkdb.erase( _forkdb.begin() );
+         --budget;
+      }
 
-         // replace old section with new section in _sections
-         _sections.erase( --_sections.end() );
-         _sections.emplace( _self, [&]( auto& r ) {
-            r = std::move( ls );
+      while ( budget > 0 && _sections.begin()->first < keep_from ){
+         _gc_st.cursor = std::min( _gc_st.cursor, _sections.begin()->first );
+         _sections.erase( _sections.begin() );
+         --budget;
+      }
+
+      const uint64_t history_length = chaindb_max_history_length * 120;
+      uint64_t end_block_num = _chaindb.rbegin()->block_num;
+      uint64_t horizon = std::min( keep_from, end_block_num > history_length ? end_block_num - history_length : 0 );
+      while ( budget > 0 && _chaindb.begin()->block_num < horizon ){
+         erase_header( _chaindb.begin() );
+         --budget;
+      }
+
+      auto itr = _chaindb.lower_bound( _gc_st.cursor );
+      while ( budget > 0 && itr != _chaindb.end() && itr->block_num < last_first ){
+         uint64_t num = itr->block_num;
+         bool needed = itr->is_anchor_block || num == keep_from || ( fallback_window <= num && num <= fallback_last );
+         itr = needed ? std::next( itr ) : erase_header( itr );
+         --budget;
+      }
+      _gc_st.cursor = itr != _chaindb.end() ? std::min( itr->block_num, last_first ) : last_first;
+   }
+
+   /**
+    * Pipeline headers store blockroot_merkle only when they are snapshots: section roots, anchor blocks and headers
+    * whose block_num is a multiple of merkle_snapshot_interval. The blockroot_merkle of any other header is the one
+    * of the header before with the block id of that header appended, it is rebuilt from the last snapshot before it.
+    */
+   incremental_merkle chain::load_blockroot_merkle( chaindb::const_iterator itr ){
+      if ( itr->blockroot_merkle._node_count != 0 ){
+         return itr->blockroot_merkle;
+      }
+
+      std::vector<block_id_type> ids;   // of the headers from the snapshot on, in descending order
+      auto it = itr;
+      do {
+         eosio_assert( it != _chaindb.begin(), "internal error: no blockroot_merkle snapshot" );
+         --it;
+         eosio_assert( it->block_num + ids.size() + 1 == itr->block_num, "internal error: blockroot_merkle snapshot unreachable" );
+         ids.push_back( it->block_id );
+      } while ( it->blockroot_merkle._node_count == 0 );
+
+      incremental_merkle blockroot_merkle = it->blockroot_merkle;
+      for ( auto id = ids.rbegin(); id != ids.rend(); ++id ){
+         blockroot_merkle.append( *id );
+      }
+      return blockroot_merkle;
+   }
+
+   /// an irreversible anchor block is appended to anchormmr at once, the others by append_irreversible_anchors()
+   void chain::store_anchor( const block_header_state& bhs, bool irreversible ){
+      const auto& row = *_anchors.emplace( _self, [&]( auto& r ) {
+         r.block_num          = bhs.block_num;
+         r.leaf_index         = irreversible ? _mmr_st.leaf_count : mmr_pending_leaf;
+         r.block_id           = bhs.block_id;
+         r.transaction_mroot  = bhs.header.transaction_mroot;
+         r.merkle_layers      = get_inc_merkle_layer_nodes( bhs.blockroot_merkle, r.merkle_nodes );
+      });
+      if ( irreversible ){
+         _mmr_st.append( get_checksum256( row ) );
+         _mmr_st.last_block_num = row.block_num;
+      }
+   }
+
+   /**
+    * Appends to anchormmr the anchor blocks of pipeline mode which no fork can erase any more: those up to proposed_lib_num
+    * of the last section, and those before its first header. The others may still be erased together with their chaindb row.
+    * An appended block can not be removed from anchormmr, so the proposed LIB is taken as final here: nodeos could only
+    * revert it if more than 1/3 of the producers confirmed conflicting blocks.
+    */
+   void chain::append_irreversible_anchors(){
+      const auto& ls = tip_section();
+      for ( auto itr = _anchors.upper_bound( _mmr_st.last_block_num );
+            itr != _anchors.end() && ( itr->block_num <= ls.proposed_lib_num || itr->block_num < ls.first ); ++itr ){
+         _anchors.modify( itr, same_payer, [&]( auto& r ) {
+            r.leaf_index = _mmr_st.leaf_count;
          });
+         _mmr_st.append( get_checksum256( *itr ));
+         _mmr_st.last_block_num = itr->block_num;
       }
    }
 
-   static const uint32_t max_delete = 150; // max delete 150 records per time, in order to avoid exceed cpu limit
-   void chain::rmfirstsctn( const name& relay ){
-      require_relay_auth( _self, relay );
+   void chain::restoreanchor( const name&                        chain_name,
+                              const anchor_block&                anchor,
+                              const std::vector<digest_type>&    mmr_path,
+                              const name&                        relay ){
+      check_chain_name( chain_name );
+      require_relay_auth( _self, _chain_name, relay );
+      eosio_assert( _reset_st.stage == name(), "the light client is being reset");
+      eosio_assert( _anchors.find( anchor.block_num ) == _anchors.end(), "anchor block already exists");
+      eosio_assert( _mmr_st.contains( anchor.leaf_index, get_checksum256( anchor ), mmr_path ), "anchor block not in table anchormmr");
+      _anchors.emplace( _self, [&]( auto& r ) { r = anchor; });
+      _gc_st.restored_anchors.push_back( anchor.block_num );
+   }
 
-      auto it = _sections.begin();
-      auto next = ++it;
-      eosio_assert( next != _sections.end(), "can not delete the last section");
-      eosio_assert( next->valid == true, "next section must be valid");
+   // ------ working tip ------ //
 
-      uint32_t count = 0;
-      auto begin = _sections.begin();
-      if ( begin->last - begin->first + 1 > max_delete ){
-         for ( uint32_t num = begin->first; num < begin->first + max_delete; ++num ){
-            auto it = _chaindb.find( num );
-            if ( it != _chaindb.end() && !it->is_anchor_block ){
-               print("-- delete block1 --");print( num );
-               _chaindb.erase( it );
-            }
+   void chain_tip::set( const block_header_state& bhs ){
+      if ( bhs.active_schedule_id != active_schedule_id ){
+         active_schedule = nullptr;
+      }
+      block_num            = bhs.block_num;
+      block_id             = bhs.block_id;
+      producer             = bhs.header.producer;
+      schedule_version     = bhs.header.schedule_version;
+      active_schedule_id   = bhs.active_schedule_id;
+      pending_schedule_id  = bhs.pending_schedule_id;
+      blockroot_merkle     = bhs.blockroot_merkle;
+      block_signing_key    = bhs.block_signing_key;
+   }
+
+   /**
+    * Reads chaindb only when the tip does not hold the requested header,
+    * i.e. for the first header of an action or after headers have been erased
+    */
+   chain_tip& chain::get_tip( uint32_t block_num ){
+      if ( _tip.block_num == 0 || ( block_num != 0 && block_num != _tip.block_num ) ){
+         auto itr = block_num != 0 ? _chaindb.find( block_num ) : --_chaindb.end();
+         eosio_assert( itr != _chaindb.end(), "unable to find key" );
+         _tip.set( *itr );
+         if ( itr->blockroot_merkle._node_count == 0 ){
+            _tip.blockroot_merkle = load_blockroot_merkle( itr );
          }
+      }
+      return _tip;
+   }
+
+   const section_type& chain::tip_section(){
+      if ( ! _tip.section_loaded ){
+         _tip.section = *_sections.rbegin();
+         _tip.section_key = _tip.section.primary_key();
+         _tip.section_loaded = true;
+      }
+      return _tip.section;
+   }
 
-         section_type sctn = *begin;
-         sctn.first += max_delete;
+   section_type& chain::modify_tip_section(){
+      tip_section();
+      _tip.section_dirty = true;
+      return _tip.section;
+   }
 
-         _sections.erase( begin );
+   /**
+    * Writes the last section once for all headers of an action. A trim moves the first block number,
+    * which is the primary key, only then the row has to be replaced instead of modified.
+    */
+   void chain::flush_tip_section(){
+      if ( ! _tip.section_dirty ){ return; }
+
+      auto itr = _sections.find( _tip.section_key );
+      eosio_assert( itr != _sections.end(), "internal error: last section not found" );
+      if ( _tip.section.primary_key() == _tip.section_key ){
+         _sections.modify( itr, same_payer, [&]( auto& r ) {
+            r = _tip.section;
+         });
+      } else {
+         _sections.erase( itr );
          _sections.emplace( _self, [&]( auto& r ) {
-            r = std::move( sctn );
+            r = _tip.section;
          });
+         _tip.section_key = _tip.section.primary_key();
+      }
+      _tip.section_dirty = false;
+   }
 
-         return;
-      } else {
-         for ( uint32_t num = begin->first; num <= begin->last; ++num ){
-            auto it = _chaindb.find( num );
-            if ( it != _chaindb.end() && !it->is_anchor_block ){
-               print("-- delete block2 --");print( num );
-               _chaindb.erase( it );
-            }
-         }
+   /// after sections was changed directly, the cached copy must not hold changes
+   void chain::reload_tip_section(){
+      eosio_assert( ! _tip.section_dirty, "internal error: unwritten changes of last section" );
+      _tip.section_loaded = false;
+   }
 
-         count += ( begin->last - begin->first + 1 );
-         _sections.erase( begin );
+   const producer_schedule_type& chain::tip_active_schedule(){
+      if ( _tip.active_schedule == nullptr ){
+         _tip.active_schedule = &_prodsches.get( _tip.active_schedule_id );
       }
+      return *_tip.active_schedule;
+   }
 
-      // do this again to ensure that all old chaindb data is deleted
-      uint32_t lwcls_first = _sections.begin()->first;
-      uint32_t end_block_num = _chaindb.rbegin()->block_num;
+   const static uint32_t max_trim = 50;
 
-      if ( end_block_num <= chaindb_max_history_length * 120 ){
-         return;
-      }
+   /**
+    * Keeps the last section between lib_depth and lib_depth + max_trim + merkle_snapshot_interval headers long by moving
+    * its first block number, the headers left out of the section are erased by collect_garbage().
+    * The new first header is the lowest stored one from first + max_trim on which is a blockroot_merkle snapshot,
+    * so that the section can be pushed again from it and the headers after it can load their blockroot_merkle.
+    */
+   void chain::trim_last_section_or_not() {
+      const auto& lwcls = tip_section();
+      if ( lwcls.last - lwcls.first <= lib_depth + max_trim + merkle_snapshot_interval ){ return; }
 
-      while ( count++ <= max_delete ){
-         auto itr = _chaindb.begin();
-         if ( itr->block_num < end_block_num - chaindb_max_history_length * 120 ){
-            _chaindb.erase( itr );
-            print("-- delete block3 --");print(itr->block_num);
-         } else { break; }
-      }
+      // every header from the first one on is stored but those skipped by pushrounds, which stores full blockroot_merkles
+      uint64_t from = ( lwcls.first + max_trim + merkle_snapshot_interval - 1 ) / merkle_snapshot_interval * merkle_snapshot_interval;
+      auto itr = _chaindb.lower_bound( from );
+      while ( itr != _chaindb.end() && itr->block_num < lwcls.last && itr->blockroot_merkle._node_count == 0 ){ ++itr; }
+      eosio_assert( itr != _chaindb.end() && itr->block_num < lwcls.last, "internal error: no blockroot_merkle snapshot to trim to" );
+
+      _gc_st.cursor = std::min( _gc_st.cursor, lwcls.first );   // the headers before the new first are no longer needed
+
+      // the new first is written together with the other changes of this action by flush_tip_section()
+      modify_tip_section().first = itr->block_num;
+   }
+
+   void chain::rmfirstsctn( const name& chain_name, const name& relay ){
+      check_chain_name( chain_name );
+      require_relay_auth( _self, _chain_name, relay );
+      eosio_assert( _gstate.consensus_algo == "pipeline"_n, "consensus algorithm must be pipeline");
+      eosio_assert( _reset_st.stage == name(), "the light client is being reset");
+      eosio_assert( _chaindb.begin() != _chaindb.end(), "the light client has not been initialized yet");
+      collect_garbage( 0 );
    }
 
    name get_scheduled_producer( uint32_t tslot, const producer_schedule& active_schedule) {
@@ -524,171 +1324,247 @@ namespace eosio {
 
 #define BIGNUM  2000
 #define MAXSPAN 4
-   void section_type::add( name prod, uint32_t num, uint32_t tslot, const producer_schedule& sch ) {
+   void section_type::add( name prod, uint32_t num, uint32_t tslot, const producer_schedule_type& sch ) {
+      const auto& schedule = sch.schedule;
+
       // one node per chain test model
-      if ( sch.producers.size() == 1 && sch.producers.front().producer_name == "eosio"_n ){  // for one node test
+      if ( schedule.producers.size() == 1 && schedule.producers.front().producer_name == "eosio"_n ){  // for one node test
          return;
       }
 
       // section create
-      if ( producers.empty() ){
-         eosio_assert( block_nums.empty(), "internal error, producers not consistent with block_nums" );
+      if ( producers_size == 0 ){
          eosio_assert( prod != name() && num != 0, "internal error, invalid parameters" );
-         producers.push_back( prod );
-         block_nums.push_back( num );
+         producers.resize( producer_history_length );
+         block_nums.resize( producer_history_length );
+         producers_head = 0;
+         producers_size = 1;
+         producers[0] = prod;
+         block_nums[0] = num;
          return;
       }
 
       eosio_assert( tslot != 0, "internal error,tslot == 0");
-      eosio_assert( sch.producers.size() > 15, "producers.size() must greater then 15" ); // should be equal to 21 infact
-      eosio_assert( get_scheduled_producer( tslot, sch ) == prod, "scheduled producer validate failed");
+      eosio_assert( schedule.producers.size() > 15, "producers.size() must greater then 15" ); // should be equal to 21 infact
+      eosio_assert( get_scheduled_producer( tslot, schedule ) == prod, "scheduled producer validate failed");
 
       // same producer, do nothing
-      if( prod == producers.back() ){
+      name last_prod = producer_back();
+      if( prod == last_prod ){
          return;
       }
 
       // producer can not repeat within last 15 producers
-      int size = producers.size();
-      int count = size > 15 ? 15 : size;
-      for ( int i = 0; i < count ; ++i){
-         eosio_assert( prod != producers[ size - 1 - i ] , "producer can not repeat within last 15 producers" );
+      uint32_t count = producers_size > 15 ? 15 : producers_size;
+      for ( uint32_t i = 0; i < count ; ++i){
+         eosio_assert( prod != producer_back(i) , "producer can not repeat within last 15 producers" );
       }
 
       // Check if the distance from producers.back() to prod is not greater then MAXSPAN
-      int index_last = BIGNUM;
-      int index_this = BIGNUM;
-      int i = 0;
-      for ( const auto& pk : sch.producers ){
-         if ( pk.producer_name == producers.back() ){
-            index_last = i;
-         }
-         if ( pk.producer_name == prod ){
-            index_this = i;
-         }
-         ++i;
-      }
+      auto last_key = sch.find_last_by_producer( last_prod );
+      auto this_key = sch.find_last_by_producer( prod );
+      int index_last = last_key != nullptr ? last_key->position : BIGNUM;
+      int index_this = this_key != nullptr ? this_key->position : BIGNUM;
       if ( index_this > index_last ){
          eosio_assert( index_this - index_last <= MAXSPAN, "exceed max span" );
       } else {
-         eosio_assert( index_last - index_this >= sch.producers.size() - MAXSPAN, "exceed max span" );
+         eosio_assert( index_last - index_this >= schedule.producers.size() - MAXSPAN, "exceed max span" );
       }
 
-      // add
-      producers.push_back( prod );
-      block_nums.push_back( num );
-
-      // trim
-      if( producers.size() > 21 ){
-         producers.erase( producers.begin() );
-         block_nums.erase( block_nums.begin() );
+      // add, overwriting the oldest entry once the ring is full
+      if ( producers_size < producer_history_length ){
+         ++producers_size;
+      } else {
+         producers_head = ( producers_head + 1 ) % producer_history_length;
       }
+      producers[ slot_back(0) ] = prod;
+      block_nums[ slot_back(0) ] = num;
    }
 
    void section_type::clear_from( uint32_t num ){
-      int pos = 0;
       eosio_assert( first < num && num <= last , "invalid number" );
 
-      while ( num <= block_nums.back() && !producers.empty() && !block_nums.empty() ){
-         producers.pop_back();
-         block_nums.pop_back();
+      while ( producers_size > 0 && num <= block_num_back() ){
+         --producers_size;
+      }
+
+      clear_confirmations();
+      if ( proposed_lib_num >= num ){
+         proposed_lib_num = 0;
+      }
+   }
+
+   /**
+    * The header num of producer confirms itself and the confirmed headers before it, like block_header_state::set_confirmed
+    * of nodeos: each header needs required_confs confirmations, a producer confirms a header at most once, and the newest
+    * header which gets all of them becomes proposed_lib_num, the dpos_proposed_irreversible_blocknum of nodeos and not
+    * its final LIB. Only the headers after proposed_lib_num are counted,
+    * at most lib_depth of them, older ones are irreversible by lib_depth anyway.
+    * The skipped headers pushrounds does not store before num are counted without the confirmation of their own producer.
+    */
+   void section_type::confirm( name prod, uint32_t num, uint16_t confirmed, uint32_t required_confs, uint32_t skipped ){
+      auto it = std::find_if( last_produced.begin(), last_produced.end(), [&]( const auto& p ){ return p.producer == prod; });
+      if ( it != last_produced.end() ){
+         eosio_assert( it->block_num + confirmed < num, "producer double-confirming known range" );
+         it->block_num = num;
+      } else {
+         last_produced.push_back( producer_confirmation{ prod, num } );
+      }
+
+      // the skipped headers before it, which no stored header has confirmed yet
+      confirm_count.insert( confirm_count.end(), skipped + 1, uint8_t( std::min<uint32_t>( required_confs, 0xff )));
+      if ( confirm_count.size() > lib_depth ){
+         confirm_count.erase( confirm_count.begin(), confirm_count.end() - lib_depth );
+      }
+
+      uint32_t blocks_to_confirm = uint32_t(confirmed) + 1;   // the header itself too
+      for ( int32_t i = int32_t(confirm_count.size()) - 1; i >= 0 && blocks_to_confirm > 0; --i, --blocks_to_confirm ){
+         if ( --confirm_count[i] == 0 ){
+            proposed_lib_num = num - ( confirm_count.size() - 1 - i );
+            confirm_count.erase( confirm_count.begin(), confirm_count.begin() + i + 1 );
+            return;
+         }
       }
    }
 
 
    // ------ pbft related functions ------ //
 
-   void chain::pushblkcmits( const std::vector<char>&    headers_data,
+   /**
+    * Recovers the signers of already checked commits, commit groups or checkpoints, in the order the relay sent them,
+    * until quorum distinct producers of the active schedule of the signed blocks are found.
+    * A repeated signature signs the same message and is recovered once, signatures after
+    * the quorum is reached are not recovered, so a relay can add spare ones for free.
+    * A message is hashed at most once, however many signatures it carries.
+    */
+   template<typename Message>
+   uint32_t chain::count_proof_producers( const std::vector<Message>& messages,
+                                          const std::vector<std::pair<block_id_type, uint64_t>>& verified,
+                                          uint32_t first_num, uint32_t quorum ) const {
+      std::set<name> producers;
+      std::vector<const signature_type*> recovered;
+      recovered.reserve( messages.size() );
+
+      for ( const auto& msg : messages ){
+         std::optional<digest_type> digest;
+         uint64_t schedule_id = verified[ msg.block_num() - first_num ].second;
+
+         for ( const auto& sig : msg.signatures() ){
+            if ( producers.size() >= quorum ){ return producers.size(); }
+
+            auto repeated = std::find_if( recovered.begin(), recovered.end(), [&]( const signature_type* s ){
+               return std::memcmp( s->data, sig.data, sizeof(signature_type) ) == 0;
+            });
+            if ( repeated != recovered.end() ){ continue; }
+            recovered.push_back( &sig );
+
+            if ( ! digest ){ digest = msg.digest(_gstate.chain_id); }
+            auto pub_key = get_public_key_form_signature( *digest, sig );
+            auto producer = get_producer_by_public_key( schedule_id, pub_key );
+            if ( producer != name() ){
+               producers.insert( producer );
+            }
+         }
+      }
+      return producers.size();
+   }
+
+   void chain::pushblkcmits( const name&                 chain_name,
+                             const std::vector<char>&    headers_data,
                              const incremental_merkle&   blockroot_merkle,
                              const std::vector<char>&    proof_data,
                              const name&                 proof_type,
                              const name&                 relay ) {
-      require_relay_auth( _self, relay );
+      check_chain_name( chain_name );
+      require_relay_auth( _self, _chain_name, relay );
 
       eosio_assert( _gstate.consensus_algo == "batch"_n, "consensus algorithm must be batch");
+      eosio_assert( _reset_st.stage == name(), "the light client is being reset");
       eosio_assert( _chaindb.begin() != _chaindb.end(), "the light client has not been initialized yet");
 
       // unpack and make basic assert
-      std::vector<signed_block_header> headers = unpack<std::vector<signed_block_header>>( headers_data );
-      eosio_assert( _chaindb.find( headers.front().block_num() ) == _chaindb.end(), "the first block header aready exist");
+      std::vector<signed_block_header_view> headers = get_header_views( headers_data );
+      eosio_assert( headers.size() > 0, "headers can not be empty");
+      auto existing = _chaindb.find( headers.front().block_num() );
+      if ( existing != _chaindb.end() ){
+         // the same batch pushed again, e.g. by another relay, it has been verified already
+         eosio_assert( is_equal_capi_checksum256( existing->block_id, headers.front().id() ), "the first block header aready exist");
+         print_f("-- block % already pushed --", headers.front().block_num());
+         return;
+      }
+      take_relay_turn( relay );   // the batch is stored from here on, or the action fails
 
       std::vector<pbft_commit> commits;
+      std::vector<pbft_commit_group> commit_groups;
       std::vector<pbft_checkpoint> checkpoints;
       if ( proof_type == "commit"_n ){
          commits = unpack<std::vector<pbft_commit>>( proof_data );
+      } else if ( proof_type == "commitgrp"_n ){
+         commit_groups = unpack<std::vector<pbft_commit_group>>( proof_data );
       } else if ( proof_type == "checkpoint"_n ){
          checkpoints = unpack<std::vector<pbft_checkpoint>>( proof_data );
       } else { eosio_assert( false, "invalid proof_type name"); }
 
-      eosio_assert( headers.size() > 0, "headers can not be empty");
       eosio_assert( blockroot_merkle._node_count != 0 && blockroot_merkle._active_nodes.size() != 0, "blockroot_merkle can not be empty");
 
-      if ( ! only_one_eosio_bp() ){
-         eosio_assert( commits.size() >= 15 || checkpoints.size() >= 15, "size of proof must not less then 15");
+      // number of signatures, only one of the proof vectors is not empty
+      uint32_t proof_size = commits.size() + checkpoints.size();
+      for ( const auto& group : commit_groups ){
+         eosio_assert( group.sender_signatures.size() > 0, "commit group without signature");
+         proof_size += group.sender_signatures.size();
       }
 
-      eosio_assert( commits.size() <= 40 && checkpoints.size() <= 40, "size of proof too large");
+      const uint32_t quorum = only_one_eosio_bp() ? 0 : pbft_quorum;
+      eosio_assert( proof_size >= quorum, "size of proof must not less then 15");
+
+      eosio_assert( proof_size <= 40, "size of proof too large");
 
       uint32_t first_num = headers.front().block_num();
       uint32_t last_num = headers.back().block_num();
 
-      // push headers
+      // push headers, only the first one is stored, the others are verified in memory
+      std::vector<std::pair<block_id_type, uint64_t>> verified;   // block id and active schedule id, by block_num - first_num
+      verified.reserve( headers.size() );
+
       push_header( headers.front(), blockroot_merkle );
-      headers.erase( headers.begin() );
-      for ( const auto & header : headers ){
-         eosio_assert( !header.new_producers,"only the first block header can contain new_producers"); // bos chain
-         remove_header_if_exist( header.block_num() );
-         push_header( header );
+      verified.emplace_back( _tip.block_id, _tip.active_schedule_id );
+      for ( auto itr = headers.begin() + 1; itr != headers.end(); ++itr ){
+         eosio_assert( !itr->has_new_producers,"only the first block header can contain new_producers"); // bos chain
+         push_header( *itr );
+         verified.emplace_back( _tip.block_id, _tip.active_schedule_id );
       }
 
-      // assert signatures
-      std::set<name> producers;
-      if ( proof_type == "commit"_n ){
-         uint32_t first_view = commits.front().view;
+      // assert proof messages, their signers are recovered only until the quorum is reached
+      uint32_t producer_count = 0;
+      if ( proof_type == "commit"_n || proof_type == "commitgrp"_n ){
+         // no message at all is a valid proof of a one producer test chain, whose quorum is 0
+         uint32_t first_view = commits.size() ? commits.front().view : commit_groups.size() ? commit_groups.front().view : 0;
 
-         for ( auto commit : commits ){
+         auto assert_commit = [&]( const auto& commit ){
             eosio_assert( commit.view == first_view, "assert commit.view == first_view failed");
             eosio_assert( commit.common.type == 1, "not commit message");
 
             uint32_t block_num = commit.block_num();
             eosio_assert( first_num <= block_num && block_num <= last_num, "invalid commit block_num");
+            eosio_assert( is_equal_capi_checksum256(commit.block_id(), verified[ block_num - first_num ].first), "invalid block_id");
+         };
+         for ( const auto& commit : commits ){ assert_commit( commit ); }
+         for ( const auto& group : commit_groups ){ assert_commit( group ); }
 
-            auto bhs = _chaindb.get( block_num );
-            eosio_assert( is_equal_capi_checksum256(commit.block_id(), bhs.block_id), "invalid block_id");
-
-            auto pub_key = get_public_key_form_signature( commit.digest(_gstate.chain_id), commit.sender_signature );
-            auto producer = get_producer_by_public_key(bhs.active_schedule_id, pub_key);
-            if( producer == name()) continue;
-
-            producers.insert( producer );
-         }
+         producer_count = commits.size() ? count_proof_producers( commits, verified, first_num, quorum )
+                                         : count_proof_producers( commit_groups, verified, first_num, quorum );
       } else if ( proof_type == "checkpoint"_n ) {
-         for (auto checkpoint : checkpoints) {
+         for ( const auto& checkpoint : checkpoints ){
             eosio_assert( checkpoint.common.type == 2, "not checkpoint message");
 
             uint32_t block_num = checkpoint.block_num();
             eosio_assert(first_num <= block_num && block_num <= last_num, "invalid checkpoint block_num");
-
-            auto bhs = _chaindb.get(block_num);
-            eosio_assert(is_equal_capi_checksum256(checkpoint.block_id(), bhs.block_id), "invalid block_id");
-
-            auto pub_key = get_public_key_form_signature( checkpoint.digest(_gstate.chain_id), checkpoint.sender_signature );
-            auto producer = get_producer_by_public_key(bhs.active_schedule_id, pub_key);
-            if( producer == name()) continue;
-
-            producers.insert(producer);
+            eosio_assert(is_equal_capi_checksum256(checkpoint.block_id(), verified[ block_num - first_num ].first), "invalid block_id");
          }
+         producer_count = count_proof_producers( checkpoints, verified, first_num, quorum );
       }
 
-      if ( ! only_one_eosio_bp() ){
-         eosio_assert( producers.size() >= 15, "assert producers.size() >= 15 failed");
-      }
-
-      // delete headers [first_num + 1, last_num]
-      for( uint32_t n = first_num + 1; n <= last_num; ++n ){
-         auto itr = _chaindb.find( n );
-         if ( itr != _chaindb.end() ){ _chaindb.erase( itr ); }
-      }
+      eosio_assert( producer_count >= quorum, "assert producers.size() >= 15 failed");
 
       // create new section and delete old section
       _sections.emplace( _self, [&]( auto& r ) {
@@ -700,17 +1576,9 @@ namespace eosio {
       if( _sections.begin()->first != _sections.rbegin()->first ){
          _sections.erase( _sections.begin() );
       }
+      reload_tip_section();
 
-      // delete old chaindb data
-      uint32_t end_block_num = _chaindb.rbegin()->block_num;
-      for ( uint32_t i = 0; i < 50; ++i ){
-         auto itr = _chaindb.begin();
-         uint32_t range_length = chaindb_max_history_length * 120;
-         if ( end_block_num > range_length && itr->block_num < end_block_num - range_length ){
-            _chaindb.erase( itr );
-            print("-- delete block --");print(itr->block_num);
-         } else { break; }
-      }
+      collect_garbage( headers.size() );
    }
 
    /*  active and pending producer schedule change process under batch pbft consensus algorithm
@@ -731,11 +1599,11 @@ namespace eosio {
     * for convenience of calculation, and doing so does not affect signatures verification
     */
 
-   void chain::push_header( const signed_block_header& header, const incremental_merkle& blockroot_merkle ) {
-      auto header_block_num = header.block_num();
-      auto header_block_id = header.id();
+   void chain::push_header( const signed_block_header_view& header_view, const incremental_merkle& blockroot_merkle ) {
+      auto header_block_num = header_view.block_num();
+      auto header_block_id = header_view.id();
 
-      auto last_bhs = *(_chaindb.rbegin());  // don't make pointer or const, for it needs change
+      auto& last_bhs = get_tip();   // replaced by this header at the end, its merkle can be moved
       eosio_assert( header_block_num > last_bhs.block_num, "invalid header_block_num" );
 
       /**
@@ -744,12 +1612,13 @@ namespace eosio {
       block_header_state bhs;
       bhs.block_num           = header_block_num;
       bhs.block_id            = std::move( header_block_id );
-      bhs.header              = std::move( header );
+      bhs.header              = header_view.get_header();
+      const auto& header      = bhs.header;
 
       // update active_schedule_id and pending_schedule_id
-      if ( header.schedule_version == last_bhs.header.schedule_version ){
+      if ( header.schedule_version == last_bhs.schedule_version ){
          bhs.active_schedule_id  = last_bhs.active_schedule_id;
-      } else if ( header.schedule_version == last_bhs.header.schedule_version + 1 ){
+      } else if ( header.schedule_version == last_bhs.schedule_version + 1 ){
          bhs.active_schedule_id  = last_bhs.pending_schedule_id;
       } else {
          eosio_assert( false, "invalid schedule_version");
@@ -769,10 +1638,12 @@ namespace eosio {
             r.id              = new_schedule_id;
             r.schedule        = *new_producers;
             r.schedule_hash   = get_schedule_hash( *new_producers );
+            r.build_producer_index();
          });
 
          if ( _prodsches.rbegin()->id - _prodsches.begin()->id >= prodsches_max_records ){
             _prodsches.erase( _prodsches.begin() );
+            _tip.active_schedule = nullptr;
          }
 
          bhs.pending_schedule_id = new_schedule_id;
@@ -793,36 +1664,99 @@ namespace eosio {
       }
 
       // handle block_signing_key
-      if ( bhs.header.producer == last_bhs.header.producer && bhs.active_schedule_id == last_bhs.active_schedule_id ){
-         bhs.block_signing_key = std::move(last_bhs.block_signing_key);
+      if ( bhs.header.producer == last_bhs.producer && bhs.active_schedule_id == last_bhs.active_schedule_id ){
+         bhs.block_signing_key = last_bhs.block_signing_key;
       } else{
          bhs.block_signing_key = get_public_key_by_producer( bhs.active_schedule_id, bhs.header.producer );
       }
 
       // verify signature
-      auto dg = bhs_sig_digest( bhs );
+      auto dg = bhs_sig_digest( bhs, header_view.digest() );
       assert_producer_signature( dg, bhs.header.producer_signature, bhs.block_signing_key );
 
       /**
-       * add to chaindb
+       * add to chaindb, only the anchor block of a batch is stored, the other headers
+       * live in the tip until the next one has been verified against them
        */
-      _chaindb.emplace( _self, [&]( auto& r ) {
-         r = std::move(bhs);
+      _tip.set( bhs );
+      if ( bhs.is_anchor_block ){
+         store_anchor( bhs, true );
+         _chaindb.emplace( _self, [&]( auto& r ) {
+            r = std::move(bhs);
+         });
+         print_f("-- block added: % --", header_block_num);
+      }
+   }
+
+   // ------ producer schedule index ------ //
+
+   /**
+    * Built once when a schedule is stored, so that signing key and producer lookups of every header, commit
+    * and checkpoint are binary searches without serializing keys.
+    */
+   void producer_schedule_type::build_producer_index(){
+      producer_keys.clear();
+      producer_keys.reserve( schedule.producers.size() );
+      for ( const auto& pk : schedule.producers ){
+         producer_key_index k;
+         k.producer = pk.producer_name;
+         k.position = producer_keys.size();
+         datastream<char*> ds( k.key.data, sizeof(capi_public_key) );
+         ds << pk.block_signing_key;
+         producer_keys.push_back( k );
+      }
+      // a repeated producer name or key keeps its schedule order, lookups find the same entry as a scan of schedule.producers
+      std::stable_sort( producer_keys.begin(), producer_keys.end(),
+                        []( const producer_key_index& a, const producer_key_index& b ){ return a.producer < b.producer; } );
+
+      eosio_assert( producer_keys.size() <= std::numeric_limits<uint16_t>::max(), "too many producers" );
+      key_order.resize( producer_keys.size() );
+      for ( uint16_t i = 0; i < key_order.size(); ++i ){
+         key_order[i] = i;
+      }
+      std::sort( key_order.begin(), key_order.end(), [&]( uint16_t a, uint16_t b ){
+         const auto& ka = producer_keys[a];
+         const auto& kb = producer_keys[b];
+         if ( is_less_capi_public_key( ka.key, kb.key ) ) return true;
+         if ( is_less_capi_public_key( kb.key, ka.key ) ) return false;
+         return ka.position < kb.position;
       });
+   }
 
-      print_f("-- block added: % --", header_block_num);
+   /// the first entry of producer in schedule.producers
+   const producer_key_index* producer_schedule_type::find_by_producer( name producer ) const {
+      auto it = std::lower_bound( producer_keys.begin(), producer_keys.end(), producer,
+                                  []( const producer_key_index& pk, name n ){ return pk.producer < n; } );
+      return it != producer_keys.end() && it->producer == producer ? &*it : nullptr;
+   }
+
+   /// the last entry of producer in schedule.producers
+   const producer_key_index* producer_schedule_type::find_last_by_producer( name producer ) const {
+      auto it = std::upper_bound( producer_keys.begin(), producer_keys.end(), producer,
+                                  []( name n, const producer_key_index& pk ){ return n < pk.producer; } );
+      return it != producer_keys.begin() && std::prev( it )->producer == producer ? &*std::prev( it ) : nullptr;
+   }
+
+   /// the first entry of key in schedule.producers
+   const producer_key_index* producer_schedule_type::find_by_key( const capi_public_key& key ) const {
+      auto it = std::lower_bound( key_order.begin(), key_order.end(), key,
+                                  [&]( uint16_t i, const capi_public_key& k ){ return is_less_capi_public_key( producer_keys[i].key, k ); } );
+      if ( it == key_order.end() || is_less_capi_public_key( key, producer_keys[*it].key ) ){
+         return nullptr;
+      }
+      return &producer_keys[*it];
    }
 
    // ------ common functions ------ //
 
-   digest_type chain::bhs_sig_digest( const block_header_state& hs ) const {
+   digest_type chain::bhs_sig_digest( const block_header_state& hs, const digest_type& header_digest ) const {
       auto it = _prodsches.find( hs.pending_schedule_id );
       eosio_assert( it != _prodsches.end(), "internal error: block_header_state::sig_digest" );
-      auto header_bmroot = get_checksum256( std::make_pair( hs.header.digest(), hs.blockroot_merkle.get_root() ));
+      auto header_bmroot = get_checksum256( std::make_pair( header_digest, hs.blockroot_merkle.get_root() ));
       return get_checksum256( std::make_pair( header_bmroot, it->schedule_hash ));
    }
 
-   capi_public_key chain::get_public_key_form_signature( digest_type digest, signature_type sig ) const {
+   capi_public_key chain::get_public_key_form_signature( const digest_type& digest, const signature_type& sig ) const {
       capi_public_key pub_key;
       size_t pubkey_size = recover_key( reinterpret_cast<const capi_checksum256*>(digest.hash),
                                         reinterpret_cast<const char*>(sig.data), 66, pub_key.data, 34 );
@@ -833,31 +1767,16 @@ namespace eosio {
    capi_public_key chain::get_public_key_by_producer( uint64_t id, const name& producer ) const {
       auto it = _prodsches.find(id);
       eosio_assert( it != _prodsches.end(), "producer schedule id not found" );
-      const producer_schedule& ps = it->schedule;
-      for( auto pk : ps.producers){
-         if( pk.producer_name == producer){
-            capi_public_key cpk;
-            eosio::datastream<char*> pubkey_ds( reinterpret_cast<char*>(cpk.data), sizeof(capi_signature) );
-            pubkey_ds << pk.block_signing_key;
-            return cpk;
-         }
-      }
-      eosio_assert(false, (string("producer not found: ") + producer.to_string()).c_str() );
-      return capi_public_key(); //never excute, just used to suppress "no return" warning
+      auto pk = it->find_by_producer( producer );
+      eosio_assert( pk != nullptr, (string("producer not found: ") + producer.to_string()).c_str() );
+      return pk->key;
    }
 
    name chain::get_producer_by_public_key( uint64_t id, const capi_public_key& pub_key ) const {
       auto it = _prodsches.find(id);
       eosio_assert( it != _prodsches.end(), "producer schedule id not found" );
-      const producer_schedule& ps = it->schedule;
-
-      auto key = unpack<public_key>(pack(pub_key));
-      for( auto pk : ps.producers){
-         if( pk.block_signing_key == key ){
-            return pk.producer_name;
-         }
-      }
-      return name();
+      auto pk = it->find_by_key( pub_key );
+      return pk != nullptr ? pk->producer : name();
    }
 
    void chain::assert_producer_signature(const digest_type& digest,
@@ -870,36 +1789,63 @@ namespace eosio {
 
    // ------ force init ------ //
 
-   void chain::forceinit(){
+   void chain::forceinit( const name& chain_name ){
+      check_chain_name( chain_name );
       check_admin_auth();
-      while ( _prodsches.begin() != _prodsches.end() ){ _prodsches.erase(_prodsches.begin()); }
-      while ( _sections.begin() != _sections.end() ){ _sections.erase(_sections.begin()); }
-      _gmutable = global_mutable{};
-
-      for ( uint32_t i = 0; i < 150; i++ ){
-         auto itr = _chaindb.begin();
-         if ( itr != _chaindb.end() ){
-            _chaindb.erase( itr );
-         } else { break; }
-      }
-
-      if( _chaindb.begin() == _chaindb.end() ){
+      if ( reset_light_client() ){
          print_f("force initialization completed");
       } else {
-         print_f("force initialization is not complete, please call forceinit() again");
+         print_f("force initialization is not complete, % rows erased, please call forceinit() again", _reset_st.rows_erased);
+      }
+   }
+
+   /**
+    * Erases at most row_budget rows of the tables holding the light client state, continuing the reset in progress
+    * or starting a new one. Returns true once all of them are empty, the reset is then finished.
+    */
+   bool chain::reset_light_client(){
+      if ( _reset_st.stage == name() ){
+         _reset_st.stage = "sections"_n;
+         _reset_st.rows_erased = 0;
       }
+      _tip = chain_tip{};   // may point to rows erased here
+
+      uint32_t budget = _gc_st.row_budget;
+      auto clear = [&]( auto& table ){
+         for ( auto itr = table.begin(); itr != table.end(); itr = table.begin() ){
+            if ( budget == 0 ){ return false; }
+            table.erase( itr );
+            --budget;
+            ++_reset_st.rows_erased;
+         }
+         return true;
+      };
+
+      if ( _reset_st.stage == "sections"_n && clear( _sections ) ){ _reset_st.stage = "prodsches"_n; }
+      if ( _reset_st.stage == "prodsches"_n && clear( _prodsches ) ){ _reset_st.stage = "chaindb"_n; }
+      if ( _reset_st.stage == "chaindb"_n && clear( _chaindb ) ){ _reset_st.stage = "forkdb"_n; }
+      if ( _reset_st.stage == "forkdb"_n && clear( _forkdb ) ){ _reset_st.stage = "anchors"_n; }
+      if ( _reset_st.stage == "anchors"_n && clear( _anchors ) ){ _reset_st.stage = name(); }
+
+      if ( _reset_st.stage != name() ){ return false; }
+      _gmutable = global_mutable{};
+      _mmr_st = anchor_mmr{};
+      _gc_st.cursor = 0;
+      _gc_st.restored_anchors.clear();
+      return true;
    }
 
    bool chain::only_one_eosio_bp(){
       eosio_assert( _sections.begin() != _sections.end(), "table sections is empty");
-      const auto& last_section = *(_sections.rbegin());
+      const auto& last_section = tip_section();
       auto active_schedule_id = _chaindb.get( last_section.last ).active_schedule_id;
       const auto& active_schedule = _prodsches.get( active_schedule_id ).schedule;
       const auto& pds = active_schedule.producers;
       return pds.size() == 1 && pds.front().producer_name == "eosio"_n;
    }
 
-   void chain::relay( string action, name relay ) {
+   void chain::relay( const name& chain_name, string action, name relay ) {
+      check_chain_name( chain_name );
       check_admin_auth();
       auto existing = _relays.find( relay.value );
 
@@ -918,7 +1864,8 @@ namespace eosio {
       eosio_assert(false,"unknown action");
    }
 
-   void chain::reqrelayauth( ){
+   void chain::reqrelayauth( const name& chain_name ){
+      check_chain_name( chain_name );
       if ( check_relay_auth ){
          eosio_assert( false, "check_relay_auth == true" );
       } else {
@@ -957,4 +1904,5 @@ namespace eosio {
 
 } /// namespace eosio
 
-EOSIO_DISPATCH( eosio::chain, (setglobal)(chaininit)(pushsection)(rmfirstsctn)(pushblkcmits)(forceinit)(relay)(reqrelayauth)(setadmin) )
+EOSIO_DISPATCH( eosio::chain, (setglobal)(chaininit)(pushsection)(rmfirstsctn)(pushblkcmits)(forceinit)(relay)(reqrelayauth)(setadmin)
+                              (setgc)(setturns)(bootstrap)(checkpoint)(pushrounds)(restoreanchor) )
@@ -35,7 +35,7 @@ namespace eosio {
             ids.push_back(ids.back());
 
          for (int i = 0; i < ids.size() / 2; i++) {
-            ids[i] = sha256hash(make_canonical_pair(ids[2 * i], ids[(2 * i) + 1]));
+            ids[i] = canonical_pair_hash(ids[2 * i], ids[(2 * i) + 1]);
          }
 
          ids.resize(ids.size() / 2);
@@ -197,7 +197,8 @@ namespace eosio {
                  const name&                            to,                   // redundant, facilitate indexing and checking
                  const asset&                           quantity,             // redundant, facilitate indexing and checking
                  const string&                          memo,
-                 const name&                            relay );
+                 const name&                            relay,
+                 const std::vector<char>&               anchor_mmr_proof );     // empty, or chain::anchor_mmr_proof of an anchor block erased from table anchors
 
       // called by ibc plugin
       [[eosio::action]]
@@ -209,7 +210,8 @@ namespace eosio {
                         const std::vector<char>&               cash_trx_block_header,
                         const std::vector<capi_checksum256>&   cash_trx_block_id_merkle_path,
                         const uint32_t&                        anchor_block_num,
-                        const transaction_id_type&             orig_trx_id );          // redundant, facilitate indexing and checking
+                        const transaction_id_type&             orig_trx_id,            // redundant, facilitate indexing and checking
+                        const std::vector<char>&               anchor_mmr_proof );     // empty, or chain::anchor_mmr_proof of an anchor block erased from table anchors
 
       // called by ibc plugin repeatedly
       [[eosio::action]]
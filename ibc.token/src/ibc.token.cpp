@@ -806,20 +806,15 @@ namespace eosio {
       eosio_assert( is_equal_capi_checksum256(check, merkle_path[0]) ||
                     is_equal_capi_checksum256(check, merkle_path[1]), "digest not in merkle tree");
 
-      digest_type result = get_checksum256( make_canonical_pair(merkle_path[0], merkle_path[1]) );
+      digest_type result = canonical_pair_hash( merkle_path[0], merkle_path[1] );
 
+      // path nodes already carry their canonical flag, canonical_pair_hash only sets the flag of result
       for( auto i = 0; i < merkle_path.size() - 3; ++i ){
-         digest_type left;
-         digest_type right;
-
          if ( is_canonical_left(merkle_path[i+2]) ){
-            left = merkle_path[i+2];
-            right = make_canonical_right( result );
+            result = canonical_pair_hash( merkle_path[i+2], result );
          } else {
-            left = make_canonical_left( result );
-            right = merkle_path[i+2];
+            result = canonical_pair_hash( result, merkle_path[i+2] );
          }
-         result = get_checksum256( std::make_pair(left,right) );
       }
       eosio_assert( is_equal_capi_checksum256(result, merkle_path.back()) ,"merkle path validate failed" );
    }
@@ -836,9 +831,11 @@ namespace eosio {
                      const name&                            to,                  // redundant, facilitate indexing and checking
                      const asset&                           quantity,            // with the token symbol of the original trx it self. redundant, facilitate indexing and checking
                      const string&                          memo,
-                     const name&                            relay ) {
+                     const name&                            relay,
+                     const std::vector<char>&               anchor_mmr_proof ) {
       auto pch = _peerchains.get( from_chain.value, "from_chain not registered");
-      chain::require_relay_auth( pch.thischain_ibc_chain_contract, relay );
+      chain::require_relay_auth( pch.thischain_ibc_chain_contract, pch.peerchain_name, relay );
+      chain::require_relay_turn( pch.thischain_ibc_chain_contract, pch.peerchain_name, relay );
 
       // check global state
       eosio_assert( _gstate.active, "global not active" );
@@ -878,15 +875,16 @@ namespace eosio {
 
       // --- validate with lwc ---
       eosio_assert( orig_trx_block_num <= anchor_block_num, "orig_trx_block_num <= anchor_block_num assert failed");
+      auto anchor = chain::get_anchor_block( pch.thischain_ibc_chain_contract, pch.peerchain_name, anchor_block_num, anchor_mmr_proof );
       if ( orig_trx_block_num < anchor_block_num ){
          block_header orig_trx_block_header = unpack<block_header>( orig_trx_block_header_data );
          eosio_assert( orig_trx_block_header.block_num() == orig_trx_block_num, "orig_trx_block_header.block_num() must equal to orig_trx_block_num");
          eosio_assert( std::memcmp(orig_trx_merkle_path.back().hash, orig_trx_block_header.transaction_mroot.hash, 32) == 0, "transaction_mroot check failed");
-         verify_merkle_path( orig_trx_block_id_merkle_path, orig_trx_block_header.id() );
+         verify_merkle_path( orig_trx_block_id_merkle_path, block_header::id_from_digest( block_header::digest_of_packed( orig_trx_block_header_data ), orig_trx_block_num ) );
          uint32_t layer = orig_trx_block_id_merkle_path.size() == 1 ? 1 : orig_trx_block_id_merkle_path.size() - 1;
-         chain::assert_anchor_block_and_merkle_node( pch.thischain_ibc_chain_contract, anchor_block_num, layer, orig_trx_block_id_merkle_path.back() );
+         chain::assert_merkle_node( anchor, layer, orig_trx_block_id_merkle_path.back() );
       } else { // orig_trx_block_num < anchor_block_num
-         chain::assert_anchor_block_and_transaction_mroot( pch.thischain_ibc_chain_contract, anchor_block_num, orig_trx_merkle_path.back() );
+         chain::assert_transaction_mroot( anchor, orig_trx_merkle_path.back() );
       }
 
       asset new_quantity;
@@ -1062,7 +1060,8 @@ namespace eosio {
                             const std::vector<char>&               cash_trx_block_header_data,
                             const std::vector<capi_checksum256>&   cash_trx_block_id_merkle_path,
                             const uint32_t&                        anchor_block_num,
-                            const transaction_id_type&             orig_trx_id ) {
+                            const transaction_id_type&             orig_trx_id,
+                            const std::vector<char>&               anchor_mmr_proof ) {
 
       auto orig_action_info = get_orignal_action_by_trx_id( from_chain, orig_trx_id );
 
@@ -1098,15 +1097,16 @@ namespace eosio {
 
       // --- validate with lwc ---
       eosio_assert( cash_trx_block_num <= anchor_block_num, "cash_trx_block_num <= anchor_block_num assert failed");
+      auto anchor = chain::get_anchor_block( pch.thischain_ibc_chain_contract, pch.peerchain_name, anchor_block_num, anchor_mmr_proof );
       if ( cash_trx_block_num < anchor_block_num ){
          block_header cash_trx_block_header = unpack<block_header>( cash_trx_block_header_data );
          eosio_assert( cash_trx_block_header.block_num() == cash_trx_block_num, "cash_trx_block_header.block_num() must equal to cash_trx_block_num");
          eosio_assert( std::memcmp(cash_trx_merkle_path.back().hash, cash_trx_block_header.transaction_mroot.hash, 32) == 0, "transaction_mroot check failed");
-         verify_merkle_path( cash_trx_block_id_merkle_path, cash_trx_block_header.id() );
+         verify_merkle_path( cash_trx_block_id_merkle_path, block_header::id_from_digest( block_header::digest_of_packed( cash_trx_block_header_data ), cash_trx_block_num ) );
          uint32_t layer = cash_trx_block_id_merkle_path.size() == 1 ? 1 : cash_trx_block_id_merkle_path.size() - 1;
-         chain::assert_anchor_block_and_merkle_node( pch.thischain_ibc_chain_contract, anchor_block_num, layer, cash_trx_block_id_merkle_path.back() );
+         chain::assert_merkle_node( anchor, layer, cash_trx_block_id_merkle_path.back() );
       } else { // cash_trx_block_num < anchor_block_num
-         chain::assert_anchor_block_and_transaction_mroot( pch.thischain_ibc_chain_contract, anchor_block_num, cash_trx_merkle_path.back() );
+         chain::assert_transaction_mroot( anchor, cash_trx_merkle_path.back() );
       }
 
       /**
@@ -1151,7 +1151,7 @@ namespace eosio {
 
    void token::rollback( name peerchain_name, const transaction_id_type trx_id, name relay ){    // notes: if non-rollbackable attacks occurred, such records need to be deleted manually, to prevent RAM consume from being maliciously occupied
       auto pch = _peerchains.get( peerchain_name.value );
-      chain::require_relay_auth( pch.thischain_ibc_chain_contract, relay );
+      chain::require_relay_auth( pch.thischain_ibc_chain_contract, pch.peerchain_name, relay );
 
       auto _origtrxs = origtrxs_table( _self, peerchain_name.value );
       auto idx = _origtrxs.get_index<"trxid"_n>();
@@ -1228,7 +1228,7 @@ namespace eosio {
    static const uint32_t min_distance = 3600 * 24 * 2 * 14;   // one day * 14 = two weeks
    void token::rmunablerb( name peerchain_name, const transaction_id_type trx_id, name relay ){
       auto pch = _peerchains.get( peerchain_name.value );
-      chain::require_relay_auth( pch.thischain_ibc_chain_contract, relay );
+      chain::require_relay_auth( pch.thischain_ibc_chain_contract, pch.peerchain_name, relay );
 
       auto _origtrxs = origtrxs_table( _self, peerchain_name.value );
       auto idx = _origtrxs.get_index<"trxid"_n>();
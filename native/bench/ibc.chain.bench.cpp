@@ -0,0 +1,362 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ *
+ *  Micro-benchmarks of the ibc.chain light client core on synthetic 21-producer chains.
+ *
+ *  Two kinds of numbers are reported:
+ *   - phases: the building blocks of header verification measured in isolation
+ *     (unpack, get_header_views, header.id(), bhs_sig_digest, signature recovery and table I/O);
+ *   - actions: chain::append_header (through pushsection), chain::push_header and
+ *     pushblkcmits run end to end, with the time spent in host intrinsics broken down.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+
+#include <ibc.chain/ibc.chain.hpp>
+#include <host/harness.hpp>
+
+using namespace eosio;
+using namespace eosio::host;
+
+namespace {
+
+   typedef std::chrono::steady_clock clock;
+
+   double elapsed_ns( clock::time_point start ) {
+      return std::chrono::duration_cast<std::chrono::nanoseconds>( clock::now() - start ).count();
+   }
+
+   // ------ report ------ //
+
+   struct action_result {
+      std::string          label;
+      uint64_t             headers = 0;
+      uint64_t             proofs = 0;
+      double               total_ns = 0;
+      host::counters       stats;
+   };
+
+   void print_phase( const char* label, double ns_per_header ) {
+      printf( "  %-34s %12.2f us\n", label, ns_per_header / 1000 );
+   }
+
+   void print_action( const action_result& r ) {
+      double n = r.headers;
+      auto us = [&]( const host::counter& c ) { return c.nanos / n / 1000; };
+      auto per = [&]( const host::counter& c ) { return c.calls / n; };
+
+      printf( "  %s\n", r.label.c_str() );
+      printf( "    headers %llu, proofs %llu, total %.2f ms\n",
+              (unsigned long long)r.headers, (unsigned long long)r.proofs, r.total_ns / 1e6 );
+      printf( "    %-26s %10s %10s\n", "per header", "us", "calls" );
+      printf( "    %-26s %10.2f\n", "total", r.total_ns / n / 1000 );
+      printf( "    %-26s %10.2f %10.2f\n", "sha256", us(r.stats.sha256), per(r.stats.sha256) );
+      printf( "    %-26s %10s %10.2f\n", "  of which header digest", "", per(r.stats.sha256_watched) );
+      printf( "    %-26s %10.2f %10.2f\n", "header signature recovery", us(r.stats.assert_recover_key), per(r.stats.assert_recover_key) );
+      printf( "    %-26s %10.2f %10.2f\n", "proof signature recovery", us(r.stats.recover_key), per(r.stats.recover_key) );
+      printf( "    %-26s %10s %10.2f\n", "table lookup", "", per(r.stats.db_lookup) );
+      printf( "    %-26s %10.2f %10.2f   %.0f bytes\n", "table read", us(r.stats.db_read), per(r.stats.db_read), r.stats.db_read.bytes / n );
+      printf( "    %-26s %10.2f %10.2f   %.0f bytes\n", "table write", us(r.stats.db_write), per(r.stats.db_write), r.stats.db_write.bytes / n );
+      printf( "    %-26s %10.2f %10.2f\n", "table erase", us(r.stats.db_erase), per(r.stats.db_erase) );
+      printf( "    ram: chaindb %llu rows %llu bytes, anchors %llu rows %llu bytes, sections %llu bytes, prodsches %llu bytes\n",
+              (unsigned long long)host::db_rows( ibc_chain_account, "chaindb"_n ),
+              (unsigned long long)host::db_bytes( ibc_chain_account, "chaindb"_n ),
+              (unsigned long long)host::db_rows( ibc_chain_account, "anchors"_n ),
+              (unsigned long long)host::db_bytes( ibc_chain_account, "anchors"_n ),
+              (unsigned long long)host::db_bytes( ibc_chain_account, "sections"_n ),
+              (unsigned long long)host::db_bytes( ibc_chain_account, "prodsches"_n ));
+   }
+
+   template<typename F>
+   action_result run_action( const std::string& label, uint64_t headers, uint64_t proofs, F&& f ) {
+      action_result r;
+      r.label = label;
+      r.headers = headers;
+      r.proofs = proofs;
+      host::reset_stats();
+      auto start = clock::now();
+      as_action( { main_relay }, std::forward<F>(f) );
+      r.total_ns = elapsed_ns( start );
+      r.stats = host::stats();
+      return r;
+   }
+
+   void accumulate( action_result& sum, const action_result& r ) {
+      auto add = []( host::counter& a, const host::counter& b ){ a.calls += b.calls; a.bytes += b.bytes; a.nanos += b.nanos; };
+      sum.headers += r.headers;
+      sum.proofs += r.proofs;
+      sum.total_ns += r.total_ns;
+      add( sum.stats.sha256, r.stats.sha256 );
+      add( sum.stats.sha256_watched, r.stats.sha256_watched );
+      add( sum.stats.recover_key, r.stats.recover_key );
+      add( sum.stats.assert_recover_key, r.stats.assert_recover_key );
+      add( sum.stats.db_lookup, r.stats.db_lookup );
+      add( sum.stats.db_read, r.stats.db_read );
+      add( sum.stats.db_write, r.stats.db_write );
+      add( sum.stats.db_erase, r.stats.db_erase );
+   }
+
+   // ------ benchmarks ------ //
+
+   void bench_phases( uint32_t count ) {
+      synthetic_chain sc( 1000 );
+      auto headers = sc.next_headers( count );
+      auto data = pack( headers );
+      auto root = sc.merkle.get_root();
+
+      printf( "phases, per header (%u headers, %zu bytes packed):\n", count, data.size() );
+
+      auto start = clock::now();
+      auto unpacked = unpack<std::vector<signed_block_header>>( data );
+      print_phase( "unpack", elapsed_ns( start ) / count );
+
+      start = clock::now();
+      auto views = get_header_views( data );
+      print_phase( "get_header_views", elapsed_ns( start ) / count );
+
+      std::vector<block_id_type> ids;
+      start = clock::now();
+      for ( const auto& h : unpacked ){
+         ids.push_back( h.id() );
+      }
+      print_phase( "header.id()", elapsed_ns( start ) / count );
+
+      std::vector<digest_type> digests;
+      start = clock::now();
+      for ( const auto& h : unpacked ){
+         auto header_bmroot = get_checksum256( std::make_pair( h.digest(), root ));
+         digests.push_back( get_checksum256( std::make_pair( header_bmroot, sc.schedule_hash )));
+      }
+      print_phase( "bhs_sig_digest", elapsed_ns( start ) / count );
+
+      capi_public_key key;
+      start = clock::now();
+      for ( uint32_t i = 0; i < count; ++i ){
+         recover_key( &digests[i], reinterpret_cast<const char*>( unpacked[i].producer_signature.data ), 66, key.data, 34 );
+      }
+      print_phase( "signature recovery", elapsed_ns( start ) / count );
+
+      const name scratch = "ibc2scratch"_n;
+      start = clock::now();
+      {
+         chaindb db( scratch, scratch.value );
+         for ( uint32_t i = 0; i < count; ++i ){
+            db.emplace( scratch, [&]( auto& r ) {
+               r.block_num          = unpacked[i].block_num();
+               r.block_id           = ids[i];
+               r.header             = unpacked[i];
+               r.active_schedule_id = 1;
+               r.pending_schedule_id= 1;
+               r.blockroot_merkle   = sc.merkle;
+            });
+         }
+      }
+      print_phase( "table I/O: chaindb emplace", elapsed_ns( start ) / count );
+
+      start = clock::now();
+      {
+         chaindb db( scratch, scratch.value );
+         for ( const auto& h : unpacked ){
+            auto bhs = db.get( h.block_num() );
+         }
+      }
+      print_phase( "table I/O: chaindb get", elapsed_ns( start ) / count );
+      printf( "\n" );
+   }
+
+   void print_anchor_lag() {
+      anchors a( ibc_chain_account, peer_chain.value );
+      chaindb db( ibc_chain_account, peer_chain.value );
+      if ( a.begin() != a.end() ){
+         printf( "    anchor lag: last anchor block %llu blocks behind the last header\n",
+                 (unsigned long long)( db.rbegin()->block_num - a.rbegin()->block_num ));
+      }
+   }
+
+   /// the checks token::cash and token::cashconfirm run against the light client, each with a fresh table instance
+   void bench_anchor_checks( uint32_t count ) {
+      anchors a( ibc_chain_account, peer_chain.value );
+      if ( a.begin() == a.end() ){
+         printf( "  anchor checks skipped, no anchor block\n" );
+         return;
+      }
+      const auto anchor = *a.rbegin();
+      uint32_t layer = __builtin_ctzll( anchor.merkle_layers ) + 1;
+      auto node = get_layer_node( anchor.merkle_layers, anchor.merkle_nodes, layer );
+
+      printf( "  anchor checks, per call (%u calls):\n", count );
+
+      host::reset_stats();
+      auto start = clock::now();
+      for ( uint32_t i = 0; i < count; ++i ){
+         chaindb db( ibc_chain_account, peer_chain.value );
+         auto bhs = db.get( anchor.block_num );
+         eosio_assert( is_equal_capi_checksum256( get_inc_merkle_node_by_layer( bhs.blockroot_merkle, layer ), node ), "node" );
+      }
+      printf( "  %-34s %12.2f us   %llu bytes read\n", "merkle node via chaindb row", elapsed_ns( start ) / count / 1000,
+              (unsigned long long)( host::stats().db_read.bytes / count ));
+
+      host::reset_stats();
+      start = clock::now();
+      for ( uint32_t i = 0; i < count; ++i ){
+         chain::assert_anchor_block_and_merkle_node( ibc_chain_account, peer_chain, anchor.block_num, layer, node );
+      }
+      printf( "  %-34s %12.2f us   %llu bytes read\n", "assert_anchor_block_and_merkle_node", elapsed_ns( start ) / count / 1000,
+              (unsigned long long)( host::stats().db_read.bytes / count ));
+
+      host::reset_stats();
+      start = clock::now();
+      for ( uint32_t i = 0; i < count; ++i ){
+         chain::assert_anchor_block_and_transaction_mroot( ibc_chain_account, peer_chain, anchor.block_num, anchor.transaction_mroot );
+      }
+      printf( "  %-34s %12.2f us   %llu bytes read\n", "assert_anchor_block_and_trx_mroot", elapsed_ns( start ) / count / 1000,
+              (unsigned long long)( host::stats().db_read.bytes / count ));
+   }
+
+   void bench_pushsection( uint32_t headers_per_push, uint32_t rounds ) {
+      synthetic_chain sc( 1000 );
+      signed_block_header genesis;
+      setup_light_client( sc, "pipeline"_n, genesis );
+
+      action_result sum;
+      sum.label = "chain::append_header via pushsection, " + std::to_string( headers_per_push ) + " headers per action";
+      for ( uint32_t i = 0; i < rounds; ++i ){
+         auto data = pack( sc.next_headers( headers_per_push ));
+         accumulate( sum, run_action( "", headers_per_push, 0, [&]( chain& c ){
+            c.pushsection( peer_chain, data, incremental_merkle(), main_relay );
+         }));
+      }
+      print_action( sum );
+      print_anchor_lag();
+      bench_anchor_checks( 1000 );
+   }
+
+   /// the same chain as bench_pushsection, pushed as the first header of each producer round and the ids of the others
+   void bench_pushrounds( uint32_t headers_per_push, uint32_t rounds ) {
+      synthetic_chain sc( 1000 );
+      signed_block_header genesis;
+      setup_light_client( sc, "pipeline"_n, genesis );
+
+      action_result sum;
+      size_t bytes = 0;
+      name last_producer = genesis.producer;
+      std::vector<block_id_type> pending;   // ids after the last pushed header, they go with the next one
+      for ( uint32_t i = 0; i < rounds; ++i ){
+         std::vector<signed_block_header> headers;
+         std::vector<block_id_type> skipped_ids;
+         for ( const auto& h : sc.next_headers( headers_per_push )){
+            if ( h.producer != last_producer ){
+               headers.push_back( h );
+               skipped_ids.insert( skipped_ids.end(), pending.begin(), pending.end() );
+               pending.clear();
+               last_producer = h.producer;
+            } else {
+               pending.push_back( h.id() );
+            }
+         }
+         auto data = pack( headers );
+         bytes += data.size() + pack( skipped_ids ).size();
+         accumulate( sum, run_action( "", headers_per_push, 0, [&]( chain& c ){
+            c.pushrounds( peer_chain, data, skipped_ids, main_relay );
+         }));
+      }
+      sum.label = "pushrounds, " + std::to_string( headers_per_push ) + " blocks per action, " +
+                  std::to_string( bytes / rounds ) + " bytes per action, per block:";
+      print_action( sum );
+      print_anchor_lag();
+   }
+
+   /// the commits of one block as the relay packs them for proof_type "commitgrp", all of them share one timestamp
+   std::vector<pbft_commit_group> group_commits( const std::vector<pbft_commit>& commits ) {
+      pbft_commit_group group;
+      group.common     = commits.front().common;
+      group.view       = commits.front().view;
+      group.block_info = commits.front().block_info;
+      for ( const auto& commit : commits ){
+         group.sender_signatures.push_back( commit.sender_signature );
+      }
+      return { group };
+   }
+
+   void bench_pushblkcmits( uint32_t headers_per_push, uint32_t rounds, name proof_type ) {
+      synthetic_chain sc( 1000 );
+      signed_block_header genesis;
+      setup_light_client( sc, "batch"_n, genesis );
+
+      action_result headers_only, full;
+      size_t proof_bytes = 0;
+      for ( uint32_t i = 0; i < rounds; ++i ){
+         auto first = sc.next_header();
+         auto first_merkle = sc.merkle;
+         auto headers = sc.next_headers( headers_per_push - 1 );
+         headers.insert( headers.begin(), first );
+         auto data = pack( headers );
+         auto commits = sc.commits( sc.last_id, i );
+         auto proof = proof_type == "commitgrp"_n ? pack( group_commits( commits )) : pack( commits );
+         proof_bytes = proof.size();
+
+         auto r = run_action( "", headers_per_push, commits.size(), [&]( chain& c ){
+            c.pushblkcmits( peer_chain, data, first_merkle, proof, proof_type, main_relay );
+         });
+         accumulate( full, r );
+
+         // push_header alone, the proof verification is dominated by recover_key
+         r.total_ns -= r.stats.recover_key.nanos;
+         r.stats.recover_key = host::counter{};
+         accumulate( headers_only, r );
+      }
+      headers_only.label = "chain::push_header via pushblkcmits, " + std::to_string( headers_per_push ) + " headers per action, proof excluded";
+      full.label = "pushblkcmits, " + std::to_string( headers_per_push ) + " headers and " + std::to_string( sc.keys.size() ) +
+                   " commits per action, proof_type " + proof_type.to_string() + ", " + std::to_string( proof_bytes ) + " proof bytes";
+      if ( proof_type == "commit"_n ){
+         print_action( headers_only );
+      }
+      print_action( full );
+   }
+
+   uint32_t arg_value( int argc, char** argv, const char* flag, uint32_t def ) {
+      for ( int i = 1; i + 1 < argc; ++i ){
+         if ( std::strcmp( argv[i], flag ) == 0 ) return std::strtoul( argv[i + 1], nullptr, 10 );
+      }
+      return def;
+   }
+
+} /// namespace
+
+int main( int argc, char** argv ) {
+   if ( argc > 1 && ( std::strcmp( argv[1], "-h" ) == 0 || std::strcmp( argv[1], "--help" ) == 0 )) {
+      printf( "usage: %s [--headers N] [--rounds R] [--batch B]\n", argv[0] );
+      printf( "  --headers N   headers per pushsection action, default 1000\n" );
+      printf( "  --rounds R    number of actions per scenario, default 3\n" );
+      printf( "  --batch B     headers per pushblkcmits action, default 50\n" );
+      return 0;
+   }
+
+   uint32_t headers = arg_value( argc, argv, "--headers", 1000 );
+   uint32_t rounds  = arg_value( argc, argv, "--rounds", 3 );
+   uint32_t batch   = arg_value( argc, argv, "--batch", 50 );
+
+   try {
+      // synthetic headers carry no new_producers nor extensions, so all packed block_headers have one size
+      const block_header& sample = synthetic_chain( 1000 ).next_header();
+      host::watch_sha256_length( pack_size( sample ));
+
+      printf( "ibc.chain native benchmark, 21 producers, secp256k1 by OpenSSL\n\n" );
+      bench_phases( headers );
+      printf( "actions:\n" );
+      bench_pushsection( headers, rounds );
+      bench_pushrounds( headers, rounds );
+      bench_pushblkcmits( batch, rounds, "commit"_n );
+      bench_pushblkcmits( batch, rounds, "commitgrp"_n );
+   } catch ( const eosio_assert_exception& e ) {
+      fprintf( stderr, "assertion failure: %s\n", e.what() );
+      return 1;
+   }
+   return 0;
+}
@@ -0,0 +1,19 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ *
+ *  Authorization checks of the host build, backed by the account and auth sets in native/src/intrinsics.cpp.
+ */
+#pragma once
+
+#include <eosiolib/name.hpp>
+
+namespace eosio {
+
+   bool has_auth( name n );
+
+   void require_auth( name n );
+
+   bool is_account( name n );
+
+} /// namespace eosio
@@ -0,0 +1,9 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ *
+ *  ibc.chain includes this header but uses no asset type, the host build keeps it empty.
+ */
+#pragma once
+
+#include <eosiolib/datastream.hpp>
@@ -0,0 +1,18 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ *
+ *  Host build replacement of eosiolib/crypto.h, implemented in native/src/intrinsics.cpp
+ *  with OpenSSL sha256 and secp256k1.
+ */
+#pragma once
+
+#include <eosiolib/types.h>
+
+void sha256( const char* data, uint32_t length, capi_checksum256* hash );
+
+void assert_sha256( const char* data, uint32_t length, const capi_checksum256* hash );
+
+int recover_key( const capi_checksum256* digest, const char* sig, size_t siglen, char* pub, size_t publen );
+
+void assert_recover_key( const capi_checksum256* digest, const char* sig, size_t siglen, const char* pub, size_t publen );
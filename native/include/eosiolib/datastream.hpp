@@ -0,0 +1,395 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ */
+#pragma once
+
+#include <array>
+#include <cstring>
+#include <map>
+#include <optional>
+#include <set>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <variant>
+#include <vector>
+
+#include <eosiolib/system.h>
+#include <eosiolib/types.h>
+#include <eosiolib/name.hpp>
+#include <eosiolib/varint.hpp>
+#include <eosiolib/serialize.hpp>
+
+namespace eosio {
+
+   template<typename T>
+   class datastream {
+   public:
+      datastream( T start, size_t s ) : _start(start), _pos(start), _end(start + s) {}
+
+      inline void skip( size_t s ) { _pos += s; }
+
+      inline bool read( char* d, size_t s ) {
+         eosio_assert( size_t(_end - _pos) >= s, "read" );
+         if ( s ){ memcpy( d, _pos, s ); }   // d is null for an empty vector
+         _pos += s;
+         return true;
+      }
+
+      inline bool write( const char* d, size_t s ) {
+         eosio_assert( _end - _pos >= (int32_t)s, "write" );
+         if ( s ){ memcpy( (void*)_pos, d, s ); }   // d is null for an empty vector
+         _pos += s;
+         return true;
+      }
+
+      inline bool put( char c ) {
+         eosio_assert( _pos < _end, "put" );
+         *_pos = c;
+         ++_pos;
+         return true;
+      }
+
+      inline bool get( unsigned char& c ) { return get( *(char*)&c ); }
+
+      inline bool get( char& c ) {
+         eosio_assert( _pos < _end, "get" );
+         c = *_pos;
+         ++_pos;
+         return true;
+      }
+
+      T pos()const { return _pos; }
+      inline bool valid()const { return _pos <= _end && _pos >= _start; }
+      inline bool seekp( size_t p ) { _pos = _start + p; return _pos <= _end; }
+      inline size_t tellp()const { return size_t(_pos - _start); }
+      inline size_t remaining()const { return _end - _pos; }
+
+   private:
+      T _start;
+      T _pos;
+      T _end;
+   };
+
+   template<>
+   class datastream<size_t> {
+   public:
+      datastream( size_t init_size = 0 ) : _size(init_size) {}
+      inline bool skip( size_t s ) { _size += s; return true; }
+      inline bool write( const char*, size_t s ) { _size += s; return true; }
+      inline bool put( char ) { ++_size; return true; }
+      inline bool valid()const { return true; }
+      inline bool seekp( size_t p ) { _size = p; return true; }
+      inline size_t tellp()const { return _size; }
+      inline size_t remaining()const { return 0; }
+
+   private:
+      size_t _size;
+   };
+
+   template<typename DataStream, typename T, std::enable_if_t<std::is_arithmetic<T>::value>* = nullptr>
+   DataStream& operator << ( DataStream& ds, const T& v ) {
+      ds.write( (const char*)&v, sizeof(T) );
+      return ds;
+   }
+
+   template<typename DataStream, typename T, std::enable_if_t<std::is_arithmetic<T>::value>* = nullptr>
+   DataStream& operator >> ( DataStream& ds, T& v ) {
+      ds.read( (char*)&v, sizeof(T) );
+      return ds;
+   }
+
+   template<typename DataStream, typename T, std::enable_if_t<std::is_enum<T>::value>* = nullptr>
+   DataStream& operator << ( DataStream& ds, const T& v ) {
+      return ds << static_cast<std::underlying_type_t<T>>( v );
+   }
+
+   template<typename DataStream, typename T, std::enable_if_t<std::is_enum<T>::value>* = nullptr>
+   DataStream& operator >> ( DataStream& ds, T& v ) {
+      std::underlying_type_t<T> u;
+      ds >> u;
+      v = static_cast<T>( u );
+      return ds;
+   }
+
+   template<typename DataStream>
+   DataStream& operator << ( DataStream& ds, const bool& d ) {
+      return ds << uint8_t(d);
+   }
+
+   template<typename DataStream>
+   DataStream& operator >> ( DataStream& ds, bool& d ) {
+      uint8_t t;
+      ds >> t;
+      d = t;
+      return ds;
+   }
+
+   template<typename DataStream>
+   DataStream& operator << ( DataStream& ds, const name& n ) {
+      return ds << n.value;
+   }
+
+   template<typename DataStream>
+   DataStream& operator >> ( DataStream& ds, name& n ) {
+      return ds >> n.value;
+   }
+
+   template<typename DataStream>
+   DataStream& operator << ( DataStream& ds, const ::capi_checksum256& cs ) {
+      ds.write( (const char*)&cs.hash[0], sizeof(cs.hash) );
+      return ds;
+   }
+
+   template<typename DataStream>
+   DataStream& operator >> ( DataStream& ds, ::capi_checksum256& cs ) {
+      ds.read( (char*)&cs.hash[0], sizeof(cs.hash) );
+      return ds;
+   }
+
+   template<typename DataStream>
+   DataStream& operator << ( DataStream& ds, const ::capi_public_key& pk ) {
+      ds.write( pk.data, sizeof(pk.data) );
+      return ds;
+   }
+
+   template<typename DataStream>
+   DataStream& operator >> ( DataStream& ds, ::capi_public_key& pk ) {
+      ds.read( pk.data, sizeof(pk.data) );
+      return ds;
+   }
+
+   template<typename DataStream>
+   DataStream& operator << ( DataStream& ds, const ::capi_signature& sig ) {
+      ds.write( (const char*)sig.data, sizeof(sig.data) );
+      return ds;
+   }
+
+   template<typename DataStream>
+   DataStream& operator >> ( DataStream& ds, ::capi_signature& sig ) {
+      ds.read( (char*)sig.data, sizeof(sig.data) );
+      return ds;
+   }
+
+   template<typename DataStream>
+   DataStream& operator << ( DataStream& ds, const std::string& v ) {
+      ds << unsigned_int( v.size() );
+      if ( v.size() )
+         ds.write( v.data(), v.size() );
+      return ds;
+   }
+
+   template<typename DataStream>
+   DataStream& operator >> ( DataStream& ds, std::string& v ) {
+      std::vector<char> tmp;
+      ds >> tmp;
+      v = tmp.size() ? std::string( tmp.data(), tmp.data() + tmp.size() ) : std::string();
+      return ds;
+   }
+
+   template<typename DataStream, typename T, std::size_t N>
+   DataStream& operator << ( DataStream& ds, const std::array<T,N>& v ) {
+      for ( const auto& i : v )
+         ds << i;
+      return ds;
+   }
+
+   template<typename DataStream, typename T, std::size_t N>
+   DataStream& operator >> ( DataStream& ds, std::array<T,N>& v ) {
+      for ( auto& i : v )
+         ds >> i;
+      return ds;
+   }
+
+   template<typename DataStream>
+   DataStream& operator << ( DataStream& ds, const std::vector<char>& v ) {
+      ds << unsigned_int( v.size() );
+      ds.write( v.data(), v.size() );
+      return ds;
+   }
+
+   template<typename DataStream>
+   DataStream& operator >> ( DataStream& ds, std::vector<char>& v ) {
+      unsigned_int s;
+      ds >> s;
+      v.resize( s.value );
+      ds.read( v.data(), v.size() );
+      return ds;
+   }
+
+   template<typename DataStream, typename T>
+   DataStream& operator << ( DataStream& ds, const std::vector<T>& v ) {
+      ds << unsigned_int( v.size() );
+      for ( const auto& i : v )
+         ds << i;
+      return ds;
+   }
+
+   template<typename DataStream, typename T>
+   DataStream& operator >> ( DataStream& ds, std::vector<T>& v ) {
+      unsigned_int s;
+      ds >> s;
+      v.resize( s.value );
+      for ( auto& i : v )
+         ds >> i;
+      return ds;
+   }
+
+   template<typename DataStream, typename T>
+   DataStream& operator << ( DataStream& ds, const std::set<T>& s ) {
+      ds << unsigned_int( s.size() );
+      for ( const auto& i : s )
+         ds << i;
+      return ds;
+   }
+
+   template<typename DataStream, typename T>
+   DataStream& operator >> ( DataStream& ds, std::set<T>& s ) {
+      s.clear();
+      unsigned_int sz;
+      ds >> sz;
+      for ( uint32_t i = 0; i < sz.value; ++i ) {
+         T v;
+         ds >> v;
+         s.emplace( std::move(v) );
+      }
+      return ds;
+   }
+
+   template<typename DataStream, typename K, typename V>
+   DataStream& operator << ( DataStream& ds, const std::map<K,V>& m ) {
+      ds << unsigned_int( m.size() );
+      for ( const auto& i : m )
+         ds << i.first << i.second;
+      return ds;
+   }
+
+   template<typename DataStream, typename K, typename V>
+   DataStream& operator >> ( DataStream& ds, std::map<K,V>& m ) {
+      m.clear();
+      unsigned_int sz;
+      ds >> sz;
+      for ( uint32_t i = 0; i < sz.value; ++i ) {
+         K k; V v;
+         ds >> k >> v;
+         m.emplace( std::move(k), std::move(v) );
+      }
+      return ds;
+   }
+
+   template<typename DataStream, typename T1, typename T2>
+   DataStream& operator << ( DataStream& ds, const std::pair<T1,T2>& t ) {
+      ds << std::get<0>(t);
+      ds << std::get<1>(t);
+      return ds;
+   }
+
+   template<typename DataStream, typename T1, typename T2>
+   DataStream& operator >> ( DataStream& ds, std::pair<T1,T2>& t ) {
+      T1 t1; T2 t2;
+      ds >> t1;
+      ds >> t2;
+      t = std::pair<T1,T2>{ std::move(t1), std::move(t2) };
+      return ds;
+   }
+
+   template<typename DataStream, typename... Args>
+   DataStream& operator << ( DataStream& ds, const std::tuple<Args...>& t ) {
+      std::apply( [&ds]( const auto&... e ) { ( (ds << e), ... ); }, t );
+      return ds;
+   }
+
+   template<typename DataStream, typename... Args>
+   DataStream& operator >> ( DataStream& ds, std::tuple<Args...>& t ) {
+      std::apply( [&ds]( auto&... e ) { ( (ds >> e), ... ); }, t );
+      return ds;
+   }
+
+   template<typename DataStream, typename T>
+   DataStream& operator << ( DataStream& ds, const std::optional<T>& opt ) {
+      char valid = opt.has_value();
+      ds << valid;
+      if ( valid )
+         ds << *opt;
+      return ds;
+   }
+
+   template<typename DataStream, typename T>
+   DataStream& operator >> ( DataStream& ds, std::optional<T>& opt ) {
+      char valid = 0;
+      ds >> valid;
+      if ( valid ) {
+         T val;
+         ds >> val;
+         opt = std::move( val );
+      } else {
+         opt.reset();
+      }
+      return ds;
+   }
+
+   template<typename DataStream, typename... Ts>
+   DataStream& operator << ( DataStream& ds, const std::variant<Ts...>& var ) {
+      unsigned_int index = var.index();
+      ds << index;
+      std::visit( [&ds]( const auto& val ) { ds << val; }, var );
+      return ds;
+   }
+
+   namespace _datastream_detail {
+      template<int I, typename DataStream, typename... Ts>
+      void deserialize( DataStream& ds, std::variant<Ts...>& var, int i ) {
+         if constexpr ( I < std::variant_size_v<std::variant<Ts...>> ) {
+            if ( i == I ) {
+               std::variant_alternative_t<I, std::variant<Ts...>> tmp;
+               ds >> tmp;
+               var.template emplace<I>( std::move(tmp) );
+            } else {
+               deserialize<I+1>( ds, var, i );
+            }
+         } else {
+            eosio_assert( false, "invalid variant index" );
+         }
+      }
+   }
+
+   template<typename DataStream, typename... Ts>
+   DataStream& operator >> ( DataStream& ds, std::variant<Ts...>& var ) {
+      unsigned_int index;
+      ds >> index;
+      _datastream_detail::deserialize<0>( ds, var, index );
+      return ds;
+   }
+
+   template<typename T>
+   size_t pack_size( const T& value ) {
+      datastream<size_t> ps;
+      ps << value;
+      return ps.tellp();
+   }
+
+   template<typename T>
+   std::vector<char> pack( const T& value ) {
+      std::vector<char> result;
+      result.resize( pack_size( value ) );
+
+      datastream<char*> ds( result.data(), result.size() );
+      ds << value;
+      return result;
+   }
+
+   template<typename T>
+   T unpack( const char* buffer, size_t len ) {
+      T result;
+      datastream<const char*> ds( buffer, len );
+      ds >> result;
+      return result;
+   }
+
+   template<typename T>
+   T unpack( const std::vector<char>& bytes ) {
+      return unpack<T>( bytes.data(), bytes.size() );
+   }
+
+} /// namespace eosio
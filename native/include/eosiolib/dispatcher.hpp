@@ -0,0 +1,9 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ *
+ *  The host build calls actions as plain member functions, no apply() entry point is generated.
+ */
+#pragma once
+
+#define EOSIO_DISPATCH( TYPE, MEMBERS )
@@ -0,0 +1,28 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ */
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <optional>
+#include <set>
+#include <string>
+#include <tuple>
+#include <variant>
+#include <vector>
+
+#include <eosiolib/system.h>
+#include <eosiolib/crypto.h>
+#include <eosiolib/action.hpp>
+#include <eosiolib/print.hpp>
+#include <eosiolib/multi_index.hpp>
+#include <eosiolib/contract.hpp>
+#include <eosiolib/dispatcher.hpp>
+
+namespace eosio {
+   static constexpr name same_payer{};
+}
@@ -0,0 +1,238 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ *
+ *  Host build replacement of eosiolib/multi_index.hpp. Rows are stored packed in an in-memory
+ *  database and deserialized once per multi_index instance on first access, like the
+ *  object cache of the real implementation, so that table I/O costs stay visible.
+ *  Secondary indices are not supported.
+ */
+#pragma once
+
+#include <iterator>
+#include <memory>
+#include <host/host.hpp>
+#include <eosiolib/datastream.hpp>
+
+namespace eosio {
+
+   template<name::raw TableName, typename T>
+   class multi_index {
+   private:
+      struct item : public T {
+         template<typename Constructor>
+         item( Constructor&& c ) { c( static_cast<T&>(*this) ); }
+         item() {}
+      };
+
+   public:
+      struct const_iterator {
+         typedef std::bidirectional_iterator_tag   iterator_category;
+         typedef const T                           value_type;
+         typedef std::ptrdiff_t                    difference_type;
+         typedef const T*                          pointer;
+         typedef const T&                          reference;
+
+         friend bool operator == ( const const_iterator& a, const const_iterator& b ) {
+            return a._item == b._item;
+         }
+         friend bool operator != ( const const_iterator& a, const const_iterator& b ) {
+            return a._item != b._item;
+         }
+
+         const T& operator*()const { return *static_cast<const T*>(_item); }
+         const T* operator->()const { return static_cast<const T*>(_item); }
+
+         const_iterator operator++(int) { const_iterator result(*this); ++(*this); return result; }
+         const_iterator operator--(int) { const_iterator result(*this); --(*this); return result; }
+
+         const_iterator& operator++() {
+            eosio_assert( _item != nullptr, "cannot increment end iterator" );
+            host::stats().db_lookup.calls++;
+            auto& rows = _multidx->rows();
+            auto next = rows.upper_bound( _item->primary_key() );
+            _item = next == rows.end() ? nullptr : &_multidx->load_object( next );
+            return *this;
+         }
+
+         const_iterator& operator--() {
+            host::stats().db_lookup.calls++;
+            auto& rows = _multidx->rows();
+            if ( _item == nullptr ) {
+               eosio_assert( !rows.empty(), "cannot decrement end iterator when the table is empty" );
+               _item = &_multidx->load_object( std::prev( rows.end() ) );
+            } else {
+               auto it = rows.lower_bound( _item->primary_key() );
+               eosio_assert( it != rows.begin(), "cannot decrement iterator at beginning of table" );
+               _item = &_multidx->load_object( std::prev( it ) );
+            }
+            return *this;
+         }
+
+         const_iterator() {}
+
+      private:
+         friend class multi_index;
+         const_iterator( const multi_index* mi, const item* i = nullptr ) : _multidx(mi), _item(i) {}
+
+         const multi_index*   _multidx = nullptr;
+         const item*          _item = nullptr;
+      };
+
+      typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+
+      multi_index( name code, uint64_t scope )
+      :_code(code), _scope(scope), _rows(&host::db_table( code.value, scope, static_cast<uint64_t>(TableName) )) {}
+
+      multi_index( const multi_index& ) = delete;
+      multi_index& operator=( const multi_index& ) = delete;
+
+      constexpr static uint64_t table_name() { return static_cast<uint64_t>(TableName); }
+      name get_code()const { return _code; }
+      uint64_t get_scope()const { return _scope; }
+
+      const_iterator cbegin()const { return lower_bound( 0 ); }
+      const_iterator begin()const  { return cbegin(); }
+      const_iterator cend()const   { return const_iterator( this ); }
+      const_iterator end()const    { return cend(); }
+
+      const_reverse_iterator crbegin()const { return std::make_reverse_iterator( cend() ); }
+      const_reverse_iterator rbegin()const  { return crbegin(); }
+      const_reverse_iterator crend()const   { return std::make_reverse_iterator( cbegin() ); }
+      const_reverse_iterator rend()const    { return crend(); }
+
+      const_iterator lower_bound( uint64_t primary )const {
+         host::stats().db_lookup.calls++;
+         auto it = rows().lower_bound( primary );
+         if ( it == rows().end() ) return end();
+         return const_iterator( this, &load_object( it ) );
+      }
+
+      const_iterator upper_bound( uint64_t primary )const {
+         host::stats().db_lookup.calls++;
+         auto it = rows().upper_bound( primary );
+         if ( it == rows().end() ) return end();
+         return const_iterator( this, &load_object( it ) );
+      }
+
+      uint64_t available_primary_key()const {
+         if ( _next_primary_key == unset_next_primary_key ) {
+            _next_primary_key = rows().empty() ? 0 : std::prev( rows().end() )->first + 1;
+         }
+         eosio_assert( _next_primary_key < no_available_primary_key, "next primary key in table is at autoincrement limit" );
+         return _next_primary_key;
+      }
+
+      const_iterator find( uint64_t primary )const {
+         host::stats().db_lookup.calls++;
+         auto it = rows().find( primary );
+         if ( it == rows().end() ) return end();
+         return const_iterator( this, &load_object( it ) );
+      }
+
+      const_iterator require_find( uint64_t primary, const char* error_msg = "unable to find key" )const {
+         auto it = find( primary );
+         eosio_assert( it != end(), error_msg );
+         return it;
+      }
+
+      const T& get( uint64_t primary, const char* error_msg = "unable to find key" )const {
+         host::stats().db_lookup.calls++;
+         auto it = rows().find( primary );
+         eosio_assert( it != rows().end(), error_msg );
+         return load_object( it );
+      }
+
+      template<typename Lambda>
+      const_iterator emplace( name payer, Lambda&& constructor ) {
+         auto i = std::make_unique<item>( [&]( auto& r ) { constructor( r ); } );
+         uint64_t pk = i->primary_key();
+         eosio_assert( rows().find( pk ) == rows().end(), "could not insert object, most likely a uniqueness constraint was violated" );
+
+         store( pk, *i );
+
+         if ( pk >= _next_primary_key || _next_primary_key == unset_next_primary_key ) {
+            _next_primary_key = ( pk >= no_available_primary_key ) ? no_available_primary_key : ( pk + 1 );
+         }
+
+         const item* ptr = i.get();
+         _items[pk] = std::move( i );
+         return const_iterator( this, ptr );
+      }
+
+      template<typename Lambda>
+      void modify( const_iterator itr, name payer, Lambda&& updater ) {
+         eosio_assert( itr != end(), "cannot pass end iterator to modify" );
+         modify( *itr, payer, std::forward<Lambda&&>(updater) );
+      }
+
+      template<typename Lambda>
+      void modify( const T& obj, name payer, Lambda&& updater ) {
+         auto& mutableitem = const_cast<item&>( static_cast<const item&>(obj) );
+         uint64_t pk = obj.primary_key();
+         updater( static_cast<T&>(mutableitem) );
+         eosio_assert( pk == obj.primary_key(), "updater cannot change primary key when modifying an object" );
+         store( pk, mutableitem );
+      }
+
+      const_iterator erase( const_iterator itr ) {
+         eosio_assert( itr != end(), "cannot pass end iterator to erase" );
+         const auto& obj = *itr;
+         ++itr;
+         erase( obj );
+         return itr;
+      }
+
+      void erase( const T& obj ) {
+         uint64_t pk = obj.primary_key();
+         auto it = rows().find( pk );
+         eosio_assert( it != rows().end(), "attempt to remove object that was not in multi_index" );
+         {
+            host::scoped_timer t( host::stats().db_erase, it->second.size() );
+            rows().erase( it );
+         }
+         auto cached = _items.find( pk );
+         if ( cached != _items.end() ) {
+            // keep the object alive, contracts may still read it after erase just like in wasm
+            _erased.emplace_back( std::move(cached->second) );
+            _items.erase( cached );
+         }
+      }
+
+   private:
+      static constexpr uint64_t unset_next_primary_key = uint64_t(-2);
+      static constexpr uint64_t no_available_primary_key = uint64_t(-2);
+
+      host::table_rows& rows()const { return *_rows; }
+
+      const item& load_object( host::table_rows::const_iterator row )const {
+         auto cached = _items.find( row->first );
+         if ( cached != _items.end() ) return *cached->second;
+
+         auto i = std::make_unique<item>();
+         {
+            host::scoped_timer t( host::stats().db_read, row->second.size() );
+            datastream<const char*> ds( row->second.data(), row->second.size() );
+            ds >> static_cast<T&>(*i);
+         }
+         const item* ptr = i.get();
+         _items[row->first] = std::move( i );
+         return *ptr;
+      }
+
+      void store( uint64_t pk, const T& obj ) {
+         host::scoped_timer t( host::stats().db_write );
+         auto& bytes = rows()[pk];
+         bytes = pack( obj );
+         t.add_bytes( bytes.size() );
+      }
+
+      name                                               _code;
+      uint64_t                                           _scope;
+      host::table_rows*                                  _rows;
+      mutable uint64_t                                   _next_primary_key = unset_next_primary_key;
+      mutable std::map<uint64_t, std::unique_ptr<item>>  _items;
+      std::vector<std::unique_ptr<item>>                 _erased;
+   };
+
+} /// namespace eosio
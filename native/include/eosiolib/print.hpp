@@ -0,0 +1,65 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ *
+ *  Console output of the host build. It is discarded unless the environment variable
+ *  IBC_HOST_PRINT is set, so that print calls do not distort benchmark numbers.
+ */
+#pragma once
+
+#include <string>
+#include <eosiolib/name.hpp>
+
+namespace eosio {
+
+   namespace host {
+      bool print_enabled();
+      void prints( const char* s, size_t len );
+   }
+
+   inline void print( const char* s ) {
+      if ( host::print_enabled() ) host::prints( s, strlen(s) );
+   }
+
+   inline void print( const std::string& s ) {
+      if ( host::print_enabled() ) host::prints( s.data(), s.size() );
+   }
+
+   inline void print( name n ) {
+      if ( host::print_enabled() ) print( n.to_string() );
+   }
+
+   inline void print( bool b ) {
+      print( b ? "true" : "false" );
+   }
+
+   template<typename T, std::enable_if_t<std::is_arithmetic<T>::value>* = nullptr>
+   inline void print( T v ) {
+      if ( host::print_enabled() ) print( std::to_string( v ) );
+   }
+
+   template<typename Arg, typename... Args>
+   void print( Arg&& a, Args&&... args ) {
+      print( std::forward<Arg>(a) );
+      print( std::forward<Args>(args)... );
+   }
+
+   inline void print_f( const char* s ) {
+      print( s );
+   }
+
+   template <typename Arg, typename... Args>
+   inline void print_f( const char* s, Arg val, Args... rest ) {
+      if ( !host::print_enabled() ) return;
+      while ( *s != '\0' ) {
+         if ( *s == '%' ) {
+            print( val );
+            print_f( s + 1, rest... );
+            return;
+         }
+         host::prints( s, 1 );
+         s++;
+      }
+   }
+
+} /// namespace eosio
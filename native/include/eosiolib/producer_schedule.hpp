@@ -0,0 +1,29 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ */
+#pragma once
+
+#include <eosiolib/public_key.hpp>
+
+namespace eosio {
+
+   struct producer_key {
+      name        producer_name;
+      public_key  block_signing_key;
+
+      friend constexpr bool operator < ( const producer_key& a, const producer_key& b ) {
+         return a.producer_name < b.producer_name;
+      }
+
+      EOSLIB_SERIALIZE( producer_key, (producer_name)(block_signing_key) )
+   };
+
+   struct producer_schedule {
+      uint32_t                     version;
+      std::vector<producer_key>    producers;
+
+      EOSLIB_SERIALIZE( producer_schedule, (version)(producers) )
+   };
+
+} /// namespace eosio
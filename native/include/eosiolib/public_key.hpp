@@ -0,0 +1,32 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ */
+#pragma once
+
+#include <eosiolib/datastream.hpp>
+
+namespace eosio {
+
+   struct public_key {
+      unsigned_int        type;
+      std::array<char,33> data;
+
+      friend bool operator == ( const public_key& a, const public_key& b ) {
+         return std::tie( a.type, a.data ) == std::tie( b.type, b.data );
+      }
+      friend bool operator != ( const public_key& a, const public_key& b ) {
+         return !( a == b );
+      }
+
+      EOSLIB_SERIALIZE( public_key, (type)(data) )
+   };
+
+   struct signature {
+      unsigned_int        type;
+      std::array<char,65> data;
+
+      EOSLIB_SERIALIZE( signature, (type)(data) )
+   };
+
+} /// namespace eosio
@@ -0,0 +1,39 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ *
+ *  Host build replacement of eosiolib/system.h. A failed assertion throws
+ *  eosio::eosio_assert_exception instead of aborting the transaction.
+ */
+#pragma once
+
+#include <stdexcept>
+#include <string>
+#include <eosiolib/types.h>
+
+namespace eosio {
+   struct eosio_assert_exception : std::runtime_error {
+      explicit eosio_assert_exception( const std::string& msg ) : std::runtime_error( msg ) {}
+   };
+}
+
+inline void eosio_assert( bool test, const char* msg ) {
+   if ( !test ) throw eosio::eosio_assert_exception( msg );
+}
+
+inline void eosio_assert( bool test, const std::string& msg ) {
+   if ( !test ) throw eosio::eosio_assert_exception( msg );
+}
+
+namespace eosio {
+   inline void check( bool pred, const char* msg ) { eosio_assert( pred, msg ); }
+   inline void check( bool pred, const std::string& msg ) { eosio_assert( pred, msg ); }
+}
+
+/// microseconds since the epoch of the pending block, see eosio::host::set_time()
+uint64_t current_time();
+
+/// seconds since the epoch of the pending block
+inline uint32_t now() {
+   return (uint32_t)( current_time() / 1000000 );
+}
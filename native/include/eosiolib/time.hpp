@@ -0,0 +1,89 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ */
+#pragma once
+
+#include <eosiolib/datastream.hpp>
+
+namespace eosio {
+
+   class microseconds {
+   public:
+      explicit microseconds( int64_t c = 0 ) : _count(c) {}
+      int64_t count()const { return _count; }
+      static microseconds maximum() { return microseconds(0x7fffffffffffffffll); }
+
+      friend bool operator == ( const microseconds& a, const microseconds& b ) { return a._count == b._count; }
+      friend bool operator != ( const microseconds& a, const microseconds& b ) { return a._count != b._count; }
+      friend bool operator <  ( const microseconds& a, const microseconds& b ) { return a._count < b._count; }
+
+      int64_t _count;
+      EOSLIB_SERIALIZE( microseconds, (_count) )
+   };
+
+   inline microseconds seconds( int64_t s ) { return microseconds( s * 1000000 ); }
+   inline microseconds milliseconds( int64_t s ) { return microseconds( s * 1000 ); }
+
+   class time_point {
+   public:
+      explicit time_point( microseconds e = microseconds() ) : elapsed(e) {}
+      const microseconds& time_since_epoch()const { return elapsed; }
+      uint32_t sec_since_epoch()const { return uint32_t(elapsed.count() / 1000000); }
+
+      friend bool operator == ( const time_point& a, const time_point& b ) { return a.elapsed == b.elapsed; }
+      friend bool operator <  ( const time_point& a, const time_point& b ) { return a.elapsed < b.elapsed; }
+
+      microseconds elapsed;
+      EOSLIB_SERIALIZE( time_point, (elapsed) )
+   };
+
+   class time_point_sec {
+   public:
+      time_point_sec() : utc_seconds(0) {}
+      explicit time_point_sec( uint32_t seconds ) : utc_seconds(seconds) {}
+      time_point_sec( const time_point& t ) : utc_seconds( uint32_t(t.time_since_epoch().count() / 1000000ll) ) {}
+
+      uint32_t sec_since_epoch()const { return utc_seconds; }
+
+      uint32_t utc_seconds;
+      EOSLIB_SERIALIZE( time_point_sec, (utc_seconds) )
+   };
+
+   /**
+    * This class is used in the block headers to represent the block time
+    * It is a parameterised class that takes an Epoch in milliseconds and
+    * and an interval in milliseconds and computes the number of slots.
+    */
+   class block_timestamp {
+   public:
+      explicit block_timestamp( uint32_t s = 0 ) : slot(s) {}
+
+      block_timestamp( const time_point& t ) { set_time_point( t ); }
+
+      time_point to_time_point()const {
+         int64_t msec = slot * (int64_t)block_interval_ms;
+         msec += block_timestamp_epoch;
+         return time_point( milliseconds( msec ) );
+      }
+
+      friend bool operator == ( const block_timestamp& a, const block_timestamp& b ) { return a.slot == b.slot; }
+      friend bool operator <  ( const block_timestamp& a, const block_timestamp& b ) { return a.slot < b.slot; }
+
+      uint32_t slot;
+      static constexpr int32_t block_interval_ms = 500;
+      static constexpr int64_t block_timestamp_epoch = 946684800000ll;  // epoch is year 2000
+
+      EOSLIB_SERIALIZE( block_timestamp, (slot) )
+
+   private:
+      void set_time_point( const time_point& t ) {
+         int64_t micro_since_epoch = t.time_since_epoch().count();
+         int64_t msec_since_epoch  = micro_since_epoch / 1000;
+         slot = uint32_t(( msec_since_epoch - block_timestamp_epoch ) / int64_t(block_interval_ms) );
+      }
+   };
+
+   typedef block_timestamp block_timestamp_type;
+
+} /// namespace eosio
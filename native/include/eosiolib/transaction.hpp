@@ -0,0 +1,16 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ *
+ *  Host build replacement of eosiolib/transaction.hpp, only the extension types.
+ */
+#pragma once
+
+#include <eosiolib/datastream.hpp>
+
+namespace eosio {
+
+   typedef std::tuple<uint16_t, std::vector<char>> extension;
+   typedef std::vector<extension> extensions_type;
+
+} /// namespace eosio
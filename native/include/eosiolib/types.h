@@ -0,0 +1,24 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ *
+ *  Host build replacement of eosiolib/types.h, only what ibc.chain needs.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef uint64_t capi_name;
+
+struct __attribute__((aligned (16))) capi_checksum256 {
+   uint8_t hash[32];
+};
+
+struct capi_public_key {
+   char data[34];
+};
+
+struct capi_signature {
+   uint8_t data[66];
+};
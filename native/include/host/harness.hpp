@@ -0,0 +1,198 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ *
+ *  Synthetic peer chains and a light client on them, shared by the benchmark and the tests.
+ */
+#pragma once
+
+#include <map>
+#include <optional>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <ibc.chain/ibc.chain.hpp>
+#include <host/host.hpp>
+
+namespace eosio { namespace host {
+
+   const name ibc_chain_account = "ibc2chain555"_n;
+   const name main_relay        = "ibc2relay555"_n;
+   const name peer_chain        = "peerchain"_n;    // scope of the light client tables
+
+   inline block_id_type make_id( uint32_t block_num, const std::string& salt ) {
+      std::string seed = salt + std::to_string( block_num );
+      block_id_type id;
+      ::sha256( seed.data(), seed.size(), &id );
+      id.hash[0] = uint8_t( block_num >> 24 );
+      id.hash[1] = uint8_t( block_num >> 16 );
+      id.hash[2] = uint8_t( block_num >> 8 );
+      id.hash[3] = uint8_t( block_num );
+      return id;
+   }
+
+   /**
+    * A chain of correctly signed headers, produced round-robin by the producers of one schedule,
+    * each producer signing producer_repetitions consecutive blocks and confirming, like nodeos,
+    * the blocks since the last one it produced.
+    * A header may propose a new schedule, the headers after it are signed over its hash and, once
+    * activate_pending() is called, produced by its producers.
+    */
+   struct synthetic_chain {
+      chain_id_type                    chain_id;
+      producer_schedule                schedule;
+      digest_type                      schedule_hash;   // of the pending schedule, which the signatures are over
+      std::vector<host::private_key>   keys;
+
+      producer_schedule                pending;         // equal to schedule when no replacement is in progress
+      std::vector<host::private_key>   pending_keys;
+
+      incremental_merkle               merkle;        // blockroot_merkle of the last produced header
+      block_id_type                    last_id;
+      uint32_t                         slot = 100000 * producer_repetitions * 21;
+      std::map<name, uint32_t>         last_produced;
+      bool                             confirming = true;   // false for producers confirming no block but their own
+
+      synthetic_chain( uint32_t first_block_num, uint32_t producer_count = 21 ) {
+         chain_id = make_id( 0, "chain_id" );
+
+         schedule = make_schedule( 1, producer_count, "prod.", keys );
+         schedule_hash = get_checksum256( schedule );
+         pending = schedule;
+         pending_keys = keys;
+
+         // blocks before first_block_num are not signed, only their ids are needed
+         for ( uint32_t num = 1; num + 1 < first_block_num; ++num ){
+            merkle.append( make_id( num, "history" ) );
+         }
+         last_id = make_id( first_block_num - 1, "history" );
+      }
+
+      /// producers prefix + 'a', prefix + 'b'... with keys derived from their names
+      static producer_schedule make_schedule( uint32_t version, uint32_t producer_count, const std::string& prefix,
+                                              std::vector<host::private_key>& keys ) {
+         producer_schedule result;
+         result.version = version;
+         keys.clear();
+         for ( uint32_t i = 0; i < producer_count; ++i ){
+            std::string account = prefix + char('a' + i);
+            keys.push_back( host::private_key::from_seed( account ) );
+            result.producers.push_back( producer_key{ name(account), keys.back().get_public_key() } );
+         }
+         return result;
+      }
+
+      /// the next header carries new_producers, a schedule of the next version signed by new_keys
+      signed_block_header next_header_proposing( producer_schedule new_schedule, std::vector<host::private_key> new_keys ) {
+         new_schedule.version = schedule.version + 1;
+         pending = std::move( new_schedule );
+         pending_keys = std::move( new_keys );
+         schedule_hash = get_checksum256( pending );
+         return next_header( pending );
+      }
+
+      /// the next headers are produced by the pending schedule, like once the header proposing it is irreversible
+      void activate_pending() {
+         schedule = pending;
+         keys = pending_keys;
+      }
+
+      signed_block_header next_header( const std::optional<producer_schedule>& new_producers = std::nullopt ) {
+         ++slot;
+         auto index = ( slot % ( schedule.producers.size() * producer_repetitions ) ) / producer_repetitions;
+
+         uint32_t num = block_header::num_from_id( last_id ) + 1;
+         auto producer = schedule.producers[index].producer_name;
+         auto last = last_produced.find( producer );
+         uint16_t confirmed = confirming && last != last_produced.end() ? std::min<uint32_t>( num - 1 - last->second, 0xffff ) : 0;
+         last_produced[producer] = num;
+
+         signed_block_header header;
+         header.timestamp.slot      = slot;
+         header.producer            = producer;
+         header.confirmed           = confirmed;
+         header.previous            = last_id;
+         header.transaction_mroot   = make_id( slot, "trx" );
+         header.action_mroot        = make_id( slot, "act" );
+         header.schedule_version    = schedule.version;
+         header.new_producers       = new_producers;
+
+         merkle.append( last_id );
+         sign( header );
+         return header;
+      }
+
+      /// signs the last produced header again, after a test changed it, as its producer if it is in the schedule
+      void sign( signed_block_header& header ) {
+         size_t index = 0;
+         while ( index + 1 < schedule.producers.size() && schedule.producers[index].producer_name != header.producer ){ ++index; }
+
+         auto header_bmroot = get_checksum256( std::make_pair( header.digest(), merkle.get_root() ));
+         auto sig_digest = get_checksum256( std::make_pair( header_bmroot, schedule_hash ));
+         header.producer_signature = keys[index].sign( sig_digest );
+         last_id = header.id();
+      }
+
+      std::vector<signed_block_header> next_headers( uint32_t count ) {
+         std::vector<signed_block_header> headers;
+         headers.reserve( count );
+         for ( uint32_t i = 0; i < count; ++i ){
+            headers.push_back( next_header() );
+         }
+         return headers;
+      }
+
+      std::vector<pbft_commit> commits( const block_id_type& block_id, uint32_t view ) {
+         std::vector<pbft_commit> result;
+         for ( const auto& key : keys ){
+            pbft_commit commit;
+            commit.common.type         = 1;
+            commit.common.timestamp    = time_point( microseconds( int64_t(slot) * 500000 ) );
+            commit.view                = view;
+            commit.block_info.block_id = block_id;
+            commit.sender_signature    = key.sign( commit.digest( chain_id ));
+            result.push_back( commit );
+         }
+         return result;
+      }
+   };
+
+   /// runs f on a contract instance constructed from data, the start of the action data
+   template<typename F>
+   void as_action( const std::set<name>& auths, F&& f, const std::vector<char>& data ) {
+      host::set_auths( auths );
+      chain c( ibc_chain_account, ibc_chain_account, datastream<const char*>( data.data(), data.size() ));
+      f( c );
+   }
+
+   template<typename F>
+   void as_action( const std::set<name>& auths, F&& f ) {
+      as_action( auths, std::forward<F>(f), pack( peer_chain ));   // the chain_name every action but setadmin starts with
+   }
+
+   /// a light client with main_relay registered, not initialized yet
+   inline void create_light_client( const synthetic_chain& sc, name consensus_algo ) {
+      host::db_clear();
+      host::add_account( ibc_chain_account );
+      host::add_account( main_relay );
+
+      as_action( { ibc_chain_account }, [&]( chain& c ){
+         c.setglobal( peer_chain, sc.chain_id, consensus_algo, false, 0 );
+      });
+      as_action( { ibc_chain_account }, [&]( chain& c ){
+         c.relay( peer_chain, "add", main_relay );
+      });
+   }
+
+   inline void setup_light_client( synthetic_chain& sc, name consensus_algo, signed_block_header& genesis ) {
+      create_light_client( sc, consensus_algo );
+
+      genesis = sc.next_header();
+      auto genesis_merkle = sc.merkle;
+      as_action( { main_relay }, [&]( chain& c ){
+         c.chaininit( peer_chain, pack( genesis ), sc.schedule, genesis_merkle, main_relay );
+      });
+   }
+
+}} /// namespace eosio::host
@@ -0,0 +1,106 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ *
+ *  Host side of the native build: in-memory database, authorization state,
+ *  secp256k1 signing for synthetic chains and per-intrinsic cost counters.
+ */
+#pragma once
+
+#include <chrono>
+#include <map>
+#include <set>
+#include <string>
+#include <tuple>
+#include <vector>
+#include <eosiolib/types.h>
+#include <eosiolib/name.hpp>
+#include <eosiolib/public_key.hpp>
+
+namespace eosio { namespace host {
+
+   // ------ counters ------ //
+
+   struct counter {
+      uint64_t    calls = 0;
+      uint64_t    bytes = 0;
+      uint64_t    nanos = 0;
+   };
+
+   struct counters {
+      counter     sha256;
+      counter     sha256_watched;      // sha256() over inputs of the watched length, see watch_sha256_length()
+      counter     recover_key;         // recover_key(), used by proof verification
+      counter     assert_recover_key;  // assert_recover_key(), used by header signature verification
+      counter     db_lookup;           // find, get, lower_bound, upper_bound and iterator steps of multi_index
+      counter     db_read;             // row deserialization, first access of a row by a multi_index instance
+      counter     db_write;            // row serialization on emplace and modify
+      counter     db_erase;
+   };
+
+   counters& stats();
+   void reset_stats();
+
+   /// count sha256() calls hashing exactly length bytes, e.g. packed block headers, 0 disables
+   void watch_sha256_length( uint32_t length );
+
+   class scoped_timer {
+   public:
+      scoped_timer( counter& c, uint64_t bytes = 0 ) : _c(c), _start(std::chrono::steady_clock::now()) {
+         _c.calls++;
+         _c.bytes += bytes;
+      }
+      ~scoped_timer() {
+         _c.nanos += std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now() - _start ).count();
+      }
+      void add_bytes( uint64_t bytes ) { _c.bytes += bytes; }
+   private:
+      counter&                                  _c;
+      std::chrono::steady_clock::time_point     _start;
+   };
+
+   // ------ database ------ //
+
+   typedef std::map<uint64_t, std::vector<char>> table_rows;
+
+   table_rows& db_table( uint64_t code, uint64_t scope, uint64_t table );
+
+   /// total packed bytes stored by code, optionally restricted to one table
+   uint64_t db_bytes( name code, name table = name() );
+
+   /// number of rows stored by code, optionally restricted to one table
+   uint64_t db_rows( name code, name table = name() );
+
+   void db_clear();
+
+   typedef std::map<std::tuple<uint64_t,uint64_t,uint64_t>, table_rows> database;   // by code, scope and table
+
+   /// copy of all tables, loaded back by the tests when an action fails, like the rollback of its transaction
+   database db_save();
+   void db_load( database saved );
+
+   // ------ authorization ------ //
+
+   void set_auths( const std::set<name>& auths );
+   void add_account( name account );
+
+   // ------ time ------ //
+
+   /// set the pending block time returned by current_time() and now(), in seconds
+   void set_time( uint32_t seconds );
+
+   // ------ keys ------ //
+
+   class private_key {
+   public:
+      /// derive a deterministic key from seed, synthetic chains only
+      static private_key from_seed( const std::string& seed );
+
+      eosio::public_key get_public_key()const;
+      capi_signature sign( const capi_checksum256& digest )const;
+
+   private:
+      std::array<uint8_t,32>  _secret;
+   };
+
+}} /// namespace eosio::host
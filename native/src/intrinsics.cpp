@@ -0,0 +1,342 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ *
+ *  Host implementations of the intrinsics used by ibc.chain.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+
+#include <openssl/bn.h>
+#include <openssl/ec.h>
+#include <openssl/evp.h>
+#include <openssl/obj_mac.h>
+#include <openssl/sha.h>
+
+#include <eosiolib/eosio.hpp>
+#include <host/host.hpp>
+
+namespace eosio { namespace host {
+
+   // ------ counters ------ //
+
+   counters& stats() {
+      static counters c;
+      return c;
+   }
+
+   void reset_stats() {
+      stats() = counters{};
+   }
+
+   uint32_t& sha256_watched_length() {
+      static uint32_t length = 0;
+      return length;
+   }
+
+   void watch_sha256_length( uint32_t length ) {
+      sha256_watched_length() = length;
+   }
+
+   // ------ print ------ //
+
+   bool print_enabled() {
+      static const bool enabled = std::getenv( "IBC_HOST_PRINT" ) != nullptr;
+      return enabled;
+   }
+
+   void prints( const char* s, size_t len ) {
+      fwrite( s, 1, len, stdout );
+   }
+
+   // ------ database ------ //
+
+   static database& tables() {
+      static database db;
+      return db;
+   }
+
+   table_rows& db_table( uint64_t code, uint64_t scope, uint64_t table ) {
+      return tables()[ database::key_type{ code, scope, table } ];
+   }
+
+   template<typename F>
+   static void for_each_table( name code, name table, F&& f ) {
+      for ( const auto& t : tables() ) {
+         if ( std::get<0>(t.first) != code.value ) continue;
+         if ( table != name() && std::get<2>(t.first) != table.value ) continue;
+         f( t.second );
+      }
+   }
+
+   uint64_t db_bytes( name code, name table ) {
+      uint64_t total = 0;
+      for_each_table( code, table, [&]( const table_rows& rows ) {
+         for ( const auto& r : rows ) total += r.second.size();
+      });
+      return total;
+   }
+
+   uint64_t db_rows( name code, name table ) {
+      uint64_t total = 0;
+      for_each_table( code, table, [&]( const table_rows& rows ) { total += rows.size(); } );
+      return total;
+   }
+
+   void db_clear() {
+      tables().clear();
+   }
+
+   database db_save() {
+      return tables();
+   }
+
+   void db_load( database saved ) {
+      tables() = std::move( saved );
+   }
+
+   // ------ authorization ------ //
+
+   static std::set<name>& auths() {
+      static std::set<name> a;
+      return a;
+   }
+
+   static std::set<name>& accounts() {
+      static std::set<name> a;
+      return a;
+   }
+
+   void set_auths( const std::set<name>& a ) {
+      auths() = a;
+   }
+
+   void add_account( name account ) {
+      accounts().insert( account );
+   }
+
+   // ------ time ------ //
+
+   static uint64_t& pending_block_time() {
+      static uint64_t t = 0;
+      return t;
+   }
+
+   void set_time( uint32_t seconds ) {
+      pending_block_time() = uint64_t(seconds) * 1000000;
+   }
+
+   // ------ secp256k1 ------ //
+
+   struct bn_deleter    { void operator()( BIGNUM* p )const { BN_free( p ); } };
+   struct point_deleter { void operator()( EC_POINT* p )const { EC_POINT_free( p ); } };
+   typedef std::unique_ptr<BIGNUM, bn_deleter>       bignum;
+   typedef std::unique_ptr<EC_POINT, point_deleter>  ec_point;
+
+   struct curve {
+      EC_GROUP*   group;
+      BIGNUM*     order;
+      BIGNUM*     half_order;
+      BIGNUM*     field;
+      BN_CTX*     ctx;
+
+      curve() {
+         group = EC_GROUP_new_by_curve_name( NID_secp256k1 );
+         ctx = BN_CTX_new();
+         order = BN_new();
+         half_order = BN_new();
+         field = BN_new();
+         EC_GROUP_get_order( group, order, ctx );
+         BN_rshift1( half_order, order );
+         EC_GROUP_get_curve( group, field, nullptr, nullptr, ctx );
+      }
+   };
+
+   static curve& k1() {
+      static curve c;
+      return c;
+   }
+
+   static bignum bn_from( const uint8_t* data, size_t len ) {
+      return bignum( BN_bin2bn( data, len, nullptr ) );
+   }
+
+   static void write_public_key( const EC_POINT* point, char out[33] ) {
+      auto& c = k1();
+      size_t len = EC_POINT_point2oct( c.group, point, POINT_CONVERSION_COMPRESSED,
+                                       reinterpret_cast<unsigned char*>(out), 33, c.ctx );
+      eosio_assert( len == 33, "unable to serialize public key" );
+   }
+
+   /// recover the public key point from a compact (r, s, recid) signature, null on failure
+   static ec_point recover_point( const uint8_t digest[32], const uint8_t r_bytes[32], const uint8_t s_bytes[32], int recid ) {
+      auto& c = k1();
+      auto r = bn_from( r_bytes, 32 );
+      auto s = bn_from( s_bytes, 32 );
+      auto e = bn_from( digest, 32 );
+
+      if ( BN_is_zero(r.get()) || BN_is_zero(s.get()) || BN_cmp( r.get(), c.order ) >= 0 || BN_cmp( s.get(), c.order ) >= 0 )
+         return nullptr;
+
+      bignum x( BN_dup( r.get() ) );
+      if ( recid & 2 ) {
+         BN_add( x.get(), x.get(), c.order );
+         if ( BN_cmp( x.get(), c.field ) >= 0 ) return nullptr;
+      }
+
+      ec_point R( EC_POINT_new( c.group ) );
+      if ( !EC_POINT_set_compressed_coordinates( c.group, R.get(), x.get(), recid & 1, c.ctx ) )
+         return nullptr;
+
+      // Q = r^-1 * ( s * R - e * G )
+      bignum rinv( BN_mod_inverse( nullptr, r.get(), c.order, c.ctx ) );
+      bignum u1( BN_new() ), u2( BN_new() );
+      BN_mod( e.get(), e.get(), c.order, c.ctx );
+      BN_mod_sub( u1.get(), c.order, e.get(), c.order, c.ctx );
+      BN_mod_mul( u1.get(), u1.get(), rinv.get(), c.order, c.ctx );
+      BN_mod_mul( u2.get(), s.get(), rinv.get(), c.order, c.ctx );
+
+      ec_point Q( EC_POINT_new( c.group ) );
+      if ( !EC_POINT_mul( c.group, Q.get(), u1.get(), R.get(), u2.get(), c.ctx ) || EC_POINT_is_at_infinity( c.group, Q.get() ) )
+         return nullptr;
+      return Q;
+   }
+
+   /// signature layout: type(0 = K1) | 27 + 4 + recid | r | s, public key layout: type(0 = K1) | compressed point
+   static bool recover( const capi_checksum256* digest, const char* sig, size_t siglen, char pub[34] ) {
+      if ( siglen != 66 || sig[0] != 0 ) return false;
+      const uint8_t* compact = reinterpret_cast<const uint8_t*>(sig) + 1;
+      if ( compact[0] < 27 || compact[0] > 34 ) return false;
+      int recid = ( compact[0] - 27 ) & 3;
+
+      auto Q = recover_point( digest->hash, compact + 1, compact + 33, recid );
+      if ( !Q ) return false;
+
+      pub[0] = 0;
+      write_public_key( Q.get(), pub + 1 );
+      return true;
+   }
+
+   private_key private_key::from_seed( const std::string& seed ) {
+      private_key k;
+      capi_checksum256 h;
+      ::sha256( seed.data(), seed.size(), &h );
+      std::copy( h.hash, h.hash + 32, k._secret.begin() );
+      return k;
+   }
+
+   eosio::public_key private_key::get_public_key()const {
+      auto& c = k1();
+      auto d = bn_from( _secret.data(), 32 );
+      ec_point P( EC_POINT_new( c.group ) );
+      EC_POINT_mul( c.group, P.get(), d.get(), nullptr, nullptr, c.ctx );
+
+      eosio::public_key pk;
+      pk.type = 0;
+      write_public_key( P.get(), pk.data.data() );
+      return pk;
+   }
+
+   /// deterministic nonce k = sha256( secret | digest | counter ), good enough for synthetic test chains
+   capi_signature private_key::sign( const capi_checksum256& digest )const {
+      auto& c = k1();
+      auto d = bn_from( _secret.data(), 32 );
+      auto e = bn_from( digest.hash, 32 );
+
+      for ( uint8_t counter = 0; ; ++counter ) {
+         std::vector<char> seed( _secret.begin(), _secret.end() );
+         seed.insert( seed.end(), digest.hash, digest.hash + 32 );
+         seed.push_back( counter );
+         capi_checksum256 kh;
+         ::sha256( seed.data(), seed.size(), &kh );
+
+         auto k = bn_from( kh.hash, 32 );
+         BN_mod( k.get(), k.get(), c.order, c.ctx );
+         if ( BN_is_zero( k.get() ) ) continue;
+
+         ec_point R( EC_POINT_new( c.group ) );
+         EC_POINT_mul( c.group, R.get(), k.get(), nullptr, nullptr, c.ctx );
+         bignum rx( BN_new() ), ry( BN_new() );
+         EC_POINT_get_affine_coordinates( c.group, R.get(), rx.get(), ry.get(), c.ctx );
+
+         int recid = BN_is_odd( ry.get() ) ? 1 : 0;
+         if ( BN_cmp( rx.get(), c.order ) >= 0 ) recid |= 2;
+
+         bignum r( BN_new() );
+         BN_mod( r.get(), rx.get(), c.order, c.ctx );
+         if ( BN_is_zero( r.get() ) ) continue;
+
+         // s = k^-1 * ( e + r * d )
+         bignum s( BN_new() ), kinv( BN_mod_inverse( nullptr, k.get(), c.order, c.ctx ) );
+         BN_mod_mul( s.get(), r.get(), d.get(), c.order, c.ctx );
+         BN_mod_add( s.get(), s.get(), e.get(), c.order, c.ctx );
+         BN_mod_mul( s.get(), s.get(), kinv.get(), c.order, c.ctx );
+         if ( BN_is_zero( s.get() ) ) continue;
+
+         if ( BN_cmp( s.get(), c.half_order ) > 0 ) {   // low s
+            BN_sub( s.get(), c.order, s.get() );
+            recid ^= 1;
+         }
+
+         capi_signature sig;
+         sig.data[0] = 0;
+         sig.data[1] = 27 + 4 + recid;
+         BN_bn2binpad( r.get(), sig.data + 2, 32 );
+         BN_bn2binpad( s.get(), sig.data + 34, 32 );
+         return sig;
+      }
+   }
+
+}} /// namespace eosio::host
+
+namespace eosio {
+
+   bool has_auth( name n ) {
+      return host::auths().count( n ) != 0;
+   }
+
+   void require_auth( name n ) {
+      eosio_assert( has_auth( n ), "missing authority of " + n.to_string() );
+   }
+
+   bool is_account( name n ) {
+      return host::accounts().count( n ) != 0;
+   }
+
+} /// namespace eosio
+
+uint64_t current_time() {
+   return eosio::host::pending_block_time();
+}
+
+void sha256( const char* data, uint32_t length, capi_checksum256* hash ) {
+   eosio::host::scoped_timer t( eosio::host::stats().sha256, length );
+   if ( length != 0 && length == eosio::host::sha256_watched_length() ){
+      eosio::host::stats().sha256_watched.calls++;
+   }
+   SHA256( reinterpret_cast<const unsigned char*>(data), length, hash->hash );
+}
+
+void assert_sha256( const char* data, uint32_t length, const capi_checksum256* hash ) {
+   capi_checksum256 h;
+   sha256( data, length, &h );
+   eosio_assert( std::memcmp( h.hash, hash->hash, 32 ) == 0, "hash mismatch" );
+}
+
+int recover_key( const capi_checksum256* digest, const char* sig, size_t siglen, char* pub, size_t publen ) {
+   eosio::host::scoped_timer t( eosio::host::stats().recover_key );
+   char recovered[34];
+   eosio_assert( eosio::host::recover( digest, sig, siglen, recovered ), "unable to recover public key from signature" );
+   size_t n = std::min( publen, sizeof(recovered) );
+   std::memcpy( pub, recovered, n );
+   return sizeof(recovered);
+}
+
+void assert_recover_key( const capi_checksum256* digest, const char* sig, size_t siglen, const char* pub, size_t publen ) {
+   eosio::host::scoped_timer t( eosio::host::stats().assert_recover_key );
+   char recovered[34];
+   eosio_assert( eosio::host::recover( digest, sig, siglen, recovered ), "unable to recover public key from signature" );
+   eosio_assert( publen == sizeof(recovered) && std::memcmp( pub, recovered, publen ) == 0, "Error expected key different than recovered key" );
+}
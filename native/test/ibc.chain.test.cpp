@@ -0,0 +1,1165 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ *
+ *  Scenario tests of the ibc.chain light client core on synthetic 21-producer chains.
+ *  Each test runs actions the way relays do and checks their outcome and the resulting tables.
+ *  A failed action leaves the tables as they were before it, like the rollback of its transaction.
+ */
+
+#include <cstdio>
+#include <functional>
+#include <map>
+#include <string>
+
+#include <host/harness.hpp>
+#include <ibc.token/types.hpp>
+
+namespace eosio {
+   digest_type merkle( std::vector<digest_type> ids );   // ibc.chain/src/merkle.cpp, not declared in a header
+}
+
+using namespace eosio;
+using namespace eosio::host;
+
+namespace {
+
+   const name other_relay = "ibc2relay444"_n;   // before main_relay in table relays
+
+   uint32_t failures = 0;
+
+   void check( bool condition, const std::string& what ) {
+      if ( ! condition ){
+         ++failures;
+         printf( "    FAILED: %s\n", what.c_str() );
+      }
+   }
+
+   /// runs an action, returns the message of the assertion it failed with or an empty string if it succeeded
+   template<typename F>
+   std::string push_action( const std::set<name>& auths, F&& f, const std::vector<char>& data = pack( peer_chain ) ) {
+      auto saved = host::db_save();
+      try {
+         as_action( auths, std::forward<F>(f), data );
+         return std::string();
+      } catch ( const eosio_assert_exception& e ) {
+         host::db_load( std::move(saved) );
+         return e.what();
+      }
+   }
+
+   void check_ok( const std::string& error, const std::string& what ) {
+      check( error.empty(), what + ", failed with \"" + error + "\"" );
+   }
+
+   void check_error( const std::string& error, const std::string& expected, const std::string& what ) {
+      check( ! expected.empty() && error.find( expected ) != std::string::npos,
+             what + ", expected \"" + expected + "\", got \"" + error + "\"" );
+   }
+
+   std::string pushsection( name relay, const std::vector<signed_block_header>& headers ) {
+      return push_action( { relay }, [&]( chain& c ){
+         c.pushsection( peer_chain, pack( headers ), incremental_merkle(), relay );
+      });
+   }
+
+   std::string as_admin( const std::function<void(chain&)>& f ) {
+      return push_action( { ibc_chain_account }, f );
+   }
+
+   uint64_t rows( name table ) {
+      return host::db_rows( ibc_chain_account, table );
+   }
+
+   section_type last_section() {
+      sections s( ibc_chain_account, peer_chain.value );
+      return *s.rbegin();
+   }
+
+   template<typename Singleton>
+   auto singleton_value() {
+      return Singleton( ibc_chain_account, peer_chain.value ).get();
+   }
+
+   /// merkle root of ids computed like nodeos, each pair packed and hashed on its own
+   digest_type reference_merkle( std::vector<digest_type> ids ) {
+      while ( ids.size() > 1 ){
+         if ( ids.size() % 2 ){ ids.push_back( ids.back() ); }
+         for ( size_t i = 0; i < ids.size() / 2; ++i ){
+            auto data = pack( make_canonical_pair( ids[2 * i], ids[2 * i + 1] ));
+            ::sha256( data.data(), data.size(), &ids[i] );
+         }
+         ids.resize( ids.size() / 2 );
+      }
+      return ids.front();
+   }
+
+   /// sha256 of the arguments packed one by one and concatenated, what get_checksum256 must hash
+   template<typename... Types>
+   digest_type reference_checksum256( const Types&... args ) {
+      std::vector<char> data;
+      ( [&]( const std::vector<char>& packed ){ data.insert( data.end(), packed.begin(), packed.end() ); }( pack( args )), ... );
+      digest_type digest;
+      ::sha256( data.data(), data.size(), &digest );
+      return digest;
+   }
+
+   /// chaindb rows before the first header of the last section which are not anchor blocks, left to the garbage collector,
+   /// and whether every header from the first one to the last one is stored
+   std::pair<uint64_t, bool> chaindb_rows() {
+      chaindb db( ibc_chain_account, peer_chain.value );
+      auto s = last_section();
+      uint64_t uncollected = 0, from_first = 0;
+      for ( const auto& r : db ){
+         if ( r.block_num < s.first ){
+            uncollected += r.is_anchor_block ? 0 : 1;
+         } else {
+            ++from_first;
+         }
+      }
+      return { uncollected, from_first == s.last - s.first + 1 };
+   }
+
+   /// block number of the header after which one of headers, from first_num on, is confirmed by 2/3+1 of 21 producers,
+   /// counting the confirmations of headers only, or 0 if none is
+   uint32_t irreversible_after( const std::vector<signed_block_header>& headers, uint32_t first_num ) {
+      std::map<uint32_t, std::set<name>> confirmers;
+      for ( const auto& h : headers ){
+         uint32_t num = h.block_num();
+         for ( uint32_t i = std::max<uint32_t>( first_num, num - h.confirmed ); i <= num; ++i ){
+            if ( confirmers[i].insert( h.producer ).second && confirmers[i].size() == 21 * 2 / 3 + 1 ){
+               return num;
+            }
+         }
+      }
+      return 0;
+   }
+
+   /// the peaks of a merkle mountain range of leaves and the path of leaf index, built from all the leaves as a relay does
+   std::pair<std::vector<digest_type>, std::vector<digest_type>> reference_mmr( const std::vector<digest_type>& leaves, uint64_t index ) {
+      std::vector<digest_type> peaks, path;
+      uint64_t offset = 0;
+      for ( int height = 63; height >= 0; --height ){
+         uint64_t size = uint64_t(1) << height;
+         if ( ! ( leaves.size() & size )){ continue; }
+         std::vector<digest_type> level( leaves.begin() + offset, leaves.begin() + offset + size );
+         uint64_t position = index - offset;
+         bool in_tree = index >= offset && index < offset + size;
+         while ( level.size() > 1 ){
+            if ( in_tree ){ path.push_back( level[ position ^ 1 ] ); }
+            for ( size_t i = 0; i < level.size() / 2; ++i ){
+               level[i] = anchor_mmr::parent( level[2 * i], level[2 * i + 1] );
+            }
+            level.resize( level.size() / 2 );
+            position >>= 1;
+         }
+         peaks.push_back( level.front() );
+         offset += size;
+      }
+      return { peaks, path };
+   }
+
+   // ------ tests ------ //
+
+   /// get_checksum256 hashes fixed size arguments from a stack buffer and the others after sizing them, both must hash
+   /// the packed arguments, as the digests of the transactions and receipts ibc.token verifies
+   void test_checksum256() {
+      auto id = make_id( 7, "checksum" );
+      pbft_message_common common{ pbft_message_type(1), time_point( microseconds( 1500000 )) };
+      check( is_equal_capi_checksum256( get_checksum256( id, common, uint32_t(3), block_info_type{ id } ),
+                                        reference_checksum256( id, common, uint32_t(3), block_info_type{ id } )), "pbft message digest" );
+      check( is_equal_capi_checksum256( get_checksum256( std::make_pair( id, id ), "ibc.token"_n ),
+                                        reference_checksum256( std::make_pair( id, id ), "ibc.token"_n )), "pair and name" );
+
+      auto key = host::private_key::from_seed( "checksum" );
+      for ( uint32_t count : { 0u, 1u, 127u, 128u, 300u } ){
+         std::string what = std::to_string( count ) + " byte packed_trx";
+         packed_transaction trx;
+         trx.compression = packed_transaction::zlib;
+         trx.packed_trx.assign( count, char( count ));
+         trx.packed_context_free_data.assign( count / 2, 'c' );
+         for ( uint32_t i = 0; i < count % 4; ++i ){
+            trx.signatures.push_back( key.sign( make_id( i, "trx" )));
+         }
+         auto expected = reference_checksum256( trx.compression, trx.packed_trx,
+                                                reference_checksum256( trx.signatures, trx.packed_context_free_data ));
+         check( is_equal_capi_checksum256( trx.packed_digest(), expected ), what + ": packed_transaction digest" );
+
+         for ( uint32_t words : { 0u, 127u, 128u, 16384u, 0xffffffffu } ){
+            transaction_receipt receipt;
+            receipt.status          = transaction_receipt_header::delayed;
+            receipt.cpu_usage_us    = count * 1000 + 1;
+            receipt.net_usage_words = words;
+            receipt.trx             = trx;
+            check( is_equal_capi_checksum256( receipt.digest(), reference_checksum256( receipt.status, receipt.cpu_usage_us,
+                                                                                       receipt.net_usage_words, expected )),
+                   what + ": receipt digest with net_usage_words " + std::to_string( words ));
+         }
+      }
+   }
+
+   /// incremental_merkle and merkle() hash node pairs in place, their roots must be those of the packed pairs
+   void test_merkle() {
+      std::vector<digest_type> ids;
+      incremental_merkle inc;
+      for ( uint32_t n = 1; n <= 1100; ++n ){
+         ids.push_back( make_id( n, "merkle" ));
+         inc.append( ids.back() );
+         if ( n <= 70 || n % 97 == 0 || n == 1024 || n == 1025 ){
+            auto expected = reference_merkle( ids );
+            check( is_equal_capi_checksum256( inc.get_root(), expected ), "incremental_merkle root of " + std::to_string(n) + " ids" );
+            check( is_equal_capi_checksum256( merkle( ids ), expected ), "merkle() of " + std::to_string(n) + " ids" );
+         }
+      }
+      auto l = make_id( 1, "left" ), r = make_id( 2, "right" );
+      check( is_equal_capi_checksum256( canonical_pair_hash( l, r ), sha256hash( make_canonical_pair( l, r ))), "canonical_pair_hash" );
+   }
+
+   /// anchor_mmr keeps the peaks of the trees of its leaves and accepts the path of each leaf only at its own index
+   void test_anchor_mmr() {
+      std::vector<digest_type> leaves;
+      anchor_mmr mmr;
+      check( ! mmr.contains( 0, make_id( 0, "leaf" ), {} ), "an empty anchormmr contains nothing" );
+      for ( uint64_t n = 1; n <= 70; ++n ){
+         leaves.push_back( make_id( n, "leaf" ));
+         mmr.append( leaves.back() );
+         std::string count = std::to_string( n ) + " leaves";
+         check( mmr.leaf_count == n && mmr.peaks.size() == size_t( __builtin_popcountll( n )), count + ": one peak per bit of leaf_count" );
+         check( pack( mmr.peaks ) == pack( reference_mmr( leaves, 0 ).first ), count + ": peaks" );
+         if ( n > 13 && n != 32 && n != 64 && n != 70 ){ continue; }
+
+         for ( uint64_t i = 0; i < n; ++i ){
+            auto path = reference_mmr( leaves, i ).second;
+            std::string leaf = count + ", leaf " + std::to_string( i );
+            check( mmr.contains( i, leaves[i], path ), leaf + ": path accepted" );
+            check( ! mmr.contains( i, leaves[ ( i + 1 ) % n ], path ) || n == 1, leaf + ": another leaf rejected" );
+            check( ! mmr.contains( i + 1, leaves[i], path ), leaf + ": wrong index rejected" );
+            check( ! mmr.contains( i ^ 1, leaves[i], path ) || ( i ^ 1 ) >= n, leaf + ": sibling index rejected" );
+            if ( ! path.empty() ){
+               auto wrong = path;
+               wrong.back().hash[0] ^= 1;
+               check( ! mmr.contains( i, leaves[i], wrong ), leaf + ": wrong path rejected" );
+               wrong = path;
+               wrong.pop_back();
+               check( ! mmr.contains( i, leaves[i], wrong ), leaf + ": short path rejected" );
+            }
+            auto longer = path;
+            longer.push_back( leaves[i] );
+            check( ! mmr.contains( i, leaves[i], longer ), leaf + ": long path rejected" );
+         }
+      }
+   }
+
+   /// digest f returns, or nothing if it fails an assertion
+   std::optional<digest_type> lookup( const std::function<digest_type()>& f ) {
+      try {
+         return f();
+      } catch ( const eosio_assert_exception& ) {
+         return std::nullopt;
+      }
+   }
+
+   /// the layer nodes of an anchors row are found, or not found, like get_inc_merkle_node_by_layer finds them
+   /// in the blockroot_merkle of the anchor block
+   void check_anchor_lookups( const anchor_block& anchor, const incremental_merkle& merkle, const std::string& what ) {
+      for ( uint32_t layer = 0; layer <= 66; ++layer ){
+         std::string node = what + ", layer " + std::to_string( layer );
+         auto expected = lookup( [&]{ return get_inc_merkle_node_by_layer( merkle, layer ); });
+         auto found = lookup( [&]{ return get_layer_node( anchor.merkle_layers, anchor.merkle_nodes, layer ); });
+         check( expected.has_value() == found.has_value() && ( ! expected || is_equal_capi_checksum256( *expected, *found )),
+                node + ": same node as get_inc_merkle_node_by_layer" );
+         if ( ! expected ){ continue; }
+
+         auto wrong = *expected;
+         wrong.hash[31] ^= 1;
+         check( lookup( [&]{ chain::assert_merkle_node( anchor, layer, *expected ); return *expected; }).has_value() &&
+                ! lookup( [&]{ chain::assert_merkle_node( anchor, layer, wrong ); return wrong; }).has_value(),
+                node + ": assert_merkle_node accepts only this node" );
+      }
+   }
+
+   /// anchors rows keep only the nodes of blockroot_merkle, their lookups must not differ from those of the full merkle
+   void test_anchor_lookups() {
+      incremental_merkle merkle;
+      for ( uint32_t n = 1; n <= 1100; ++n ){
+         merkle.append( make_id( n, "anchor" ));
+         if ( n > 70 && n % 97 != 0 && n != 1023 && n != 1024 && n != 1025 ){ continue; }
+         anchor_block anchor;
+         anchor.merkle_layers = get_inc_merkle_layer_nodes( merkle, anchor.merkle_nodes );
+         check_anchor_lookups( anchor, merkle, std::to_string( n ) + " ids" );
+      }
+
+      // the rows the contract writes, against the chaindb rows of the same blocks
+      synthetic_chain sc( 1000 );
+      signed_block_header genesis;
+      setup_light_client( sc, "pipeline"_n, genesis );
+      for ( uint32_t i = 0; i < 4; ++i ){
+         check_ok( pushsection( main_relay, sc.next_headers( 100 )), "push 100 headers" );
+      }
+      chaindb db( ibc_chain_account, peer_chain.value );
+      anchors a( ibc_chain_account, peer_chain.value );
+      uint32_t compared = 0;
+      for ( const auto& r : a ){
+         auto state = db.find( r.block_num );
+         if ( state == db.end() ){ continue; }
+         std::string what = "anchor block " + std::to_string( r.block_num );
+         check( state->is_anchor_block && is_equal_capi_checksum256( r.block_id, state->block_id ) &&
+                is_equal_capi_checksum256( r.transaction_mroot, state->header.transaction_mroot ), what + ": id and transaction_mroot" );
+         check_anchor_lookups( r, state->blockroot_merkle, what );
+         ++compared;
+      }
+      check( compared > 1, "anchors rows compared with chaindb" );
+   }
+
+   /// repeated producer names and keys resolve like a scan of schedule.producers: the first entry,
+   /// or the last one for the span check of section_type::add
+   void test_producer_index() {
+      synthetic_chain sc( 1000, 6 );
+      producer_schedule_type sch;
+      sch.schedule = sc.schedule;
+      sch.schedule.producers[4].producer_name = sch.schedule.producers[1].producer_name;       // prod.b at 1 and 4
+      sch.schedule.producers[2].producer_name = "prod.z"_n;
+      sch.schedule.producers[5].block_signing_key = sch.schedule.producers[2].block_signing_key;   // key of prod.z at 2 and 5
+      sch.schedule.producers[3].producer_name = sch.schedule.producers[1].producer_name;       // prod.b at 1, 3 and 4
+      sch.build_producer_index();
+
+      auto b = sch.schedule.producers[1].producer_name;
+      check( sch.find_by_producer( b ) != nullptr && sch.find_by_producer( b )->position == 1, "first entry of a repeated producer" );
+      check( sch.find_last_by_producer( b ) != nullptr && sch.find_last_by_producer( b )->position == 4, "last entry of a repeated producer" );
+      check( sch.find_by_producer( "prod.y"_n ) == nullptr && sch.find_last_by_producer( "prod.y"_n ) == nullptr, "unknown producer" );
+
+      for ( uint32_t i = 0; i < sch.schedule.producers.size(); ++i ){
+         capi_public_key key;
+         datastream<char*> ds( key.data, sizeof(key) );
+         ds << sch.schedule.producers[i].block_signing_key;
+         uint32_t first = i == 5 ? 2 : i;
+         auto found = sch.find_by_key( key );
+         check( found != nullptr && found->position == first && found->producer == sch.schedule.producers[first].producer_name,
+                "first entry of key " + std::to_string(i) );
+      }
+   }
+
+   std::string pushblkcmits( const std::vector<signed_block_header>& headers, const incremental_merkle& merkle,
+                             const std::vector<char>& proof, name proof_type ) {
+      return push_action( { main_relay }, [&]( chain& c ){
+         c.pushblkcmits( peer_chain, pack( headers ), merkle, proof, proof_type, main_relay );
+      });
+   }
+
+   /// a one producer test chain, whose single producer is eosio, needs no pbft message in the proof of a batch
+   void test_one_producer_batch() {
+      synthetic_chain sc( 1000, 1 );
+      sc.schedule.producers[0].producer_name = "eosio"_n;
+      sc.schedule_hash = get_checksum256( sc.schedule );
+      signed_block_header genesis;
+      setup_light_client( sc, "batch"_n, genesis );
+
+      for ( auto proof_type : { "commit"_n, "commitgrp"_n, "checkpoint"_n } ){
+         auto first = sc.next_header();
+         auto merkle = sc.merkle;
+         auto headers = sc.next_headers( 4 );
+         headers.insert( headers.begin(), first );
+         check_ok( pushblkcmits( headers, merkle, pack( std::vector<char>() ), proof_type ),
+                   "empty proof of type " + proof_type.to_string() );
+         check( last_section().first == first.block_num(), "batch stored with proof_type " + proof_type.to_string() );
+      }
+
+      // the proof of a 21 producer chain is still required
+      synthetic_chain sc21( 1000 );
+      setup_light_client( sc21, "batch"_n, genesis );
+      auto first = sc21.next_header();
+      auto merkle = sc21.merkle;
+      check_error( pushblkcmits( { first }, merkle, pack( std::vector<char>() ), "commit"_n ), "size of proof must not less then 15",
+                   "empty proof of a 21 producer chain" );
+   }
+
+   /// a batch is verified in memory, only its first header is stored: the tables must be those a batch of the first
+   /// header alone leaves, with the proof of that header
+   void test_batch_in_memory() {
+      synthetic_chain sc( 1000 );
+      signed_block_header genesis;
+      setup_light_client( sc, "batch"_n, genesis );
+      check_ok( as_admin( [&]( chain& c ){ c.setgc( peer_chain, 1000000 ); }), "collect all garbage in each action" );
+
+      std::vector<host::private_key> new_keys;
+      auto new_schedule = synthetic_chain::make_schedule( 0, 21, "prod.", new_keys );
+      new_keys.back() = host::private_key::from_seed( "prod.z" );
+      new_schedule.producers.back() = producer_key{ "prod.z"_n, new_keys.back().get_public_key() };
+
+      for ( bool proposing : { false, true } ){
+         std::string what = proposing ? "batch proposing a new schedule" : "batch";
+         auto first = proposing ? sc.next_header_proposing( new_schedule, new_keys ) : sc.next_header();
+         auto merkle = sc.merkle;
+         auto headers = sc.next_headers( 49 );
+         headers.insert( headers.begin(), first );
+
+         auto saved = host::db_save();
+         check_ok( pushblkcmits( { first }, merkle, pack( sc.commits( first.id(), 1 )), "commit"_n ), what + ": push the first header" );
+         auto first_only = host::db_save();
+         host::db_load( std::move( saved ));
+         check_ok( pushblkcmits( headers, merkle, pack( sc.commits( headers.back().id(), 1 )), "commit"_n ), what + ": push 50 headers" );
+         check( host::db_save() == first_only, what + ": the same tables as a batch of the first header" );
+      }
+   }
+
+   /// signers of a batch proof, commits or a commit group, are recovered until 15 distinct producers are found,
+   /// a repeated signature only once
+   void test_pbft_proofs() {
+      synthetic_chain sc( 1000 );
+      signed_block_header genesis;
+      setup_light_client( sc, "batch"_n, genesis );
+
+      auto first = sc.next_header();
+      auto merkle = sc.merkle;
+      auto headers = sc.next_headers( 4 );
+      headers.insert( headers.begin(), first );
+      auto commits = sc.commits( headers.back().id(), 1 );
+
+      auto group_of = []( const std::vector<pbft_commit>& messages ){
+         pbft_commit_group group;
+         group.common     = messages.front().common;
+         group.view       = messages.front().view;
+         group.block_info = messages.front().block_info;
+         for ( const auto& m : messages ){ group.sender_signatures.push_back( m.sender_signature ); }
+         return std::vector<pbft_commit_group>{ group };
+      };
+      auto push = [&]( const auto& proof, name proof_type, uint64_t recovered, const std::string& expected, const std::string& what ){
+         host::reset_stats();
+         auto error = pushblkcmits( headers, merkle, pack( proof ), proof_type );
+         if ( expected.empty() ){ check_ok( error, what ); }
+         else { check_error( error, expected, what ); }
+         check( host::stats().recover_key.calls == recovered, what + ", recovered " + std::to_string( recovered ) + " signers" );
+      };
+
+      std::vector<pbft_commit> below( commits.begin(), commits.begin() + 14 );
+      auto repeated = below;
+      repeated.push_back( below[3] );
+
+      push( below, "commit"_n, 0, "size of proof must not less then 15", "commit below quorum" );
+      push( repeated, "commit"_n, 14, "assert producers.size() >= 15 failed", "commit quorum with a repeated signature" );
+      push( group_of( below ), "commitgrp"_n, 0, "size of proof must not less then 15", "commitgrp below quorum" );
+      push( group_of( repeated ), "commitgrp"_n, 14, "assert producers.size() >= 15 failed", "commitgrp quorum with a repeated signature" );
+
+      // the early exit, the six signatures after the quorum are not recovered
+      push( commits, "commit"_n, 15, "", "commit of all producers" );
+      check( last_section().first == first.block_num(), "batch stored with a commit proof" );
+
+      first = sc.next_header();
+      merkle = sc.merkle;
+      headers = sc.next_headers( 4 );
+      headers.insert( headers.begin(), first );
+      commits = sc.commits( headers.back().id(), 1 );
+      commits.resize( 15 );
+      push( commits, "commit"_n, 15, "", "commit of exactly the quorum" );
+      check( last_section().first == first.block_num(), "batch stored with exactly the quorum" );
+
+      first = sc.next_header();
+      merkle = sc.merkle;
+      headers = sc.next_headers( 4 );
+      headers.insert( headers.begin(), first );
+      push( group_of( sc.commits( headers.back().id(), 1 )), "commitgrp"_n, 15, "", "commitgrp of all producers" );
+      check( last_section().first == first.block_num(), "batch stored with a commitgrp proof" );
+   }
+
+   /// each action visits at most row_budget rows plus one per pushed header, from the cursor up to the first header
+   /// of the last section, which keeps all its headers
+   void test_garbage_collection() {
+      synthetic_chain sc( 1000 );
+      signed_block_header genesis;
+      setup_light_client( sc, "pipeline"_n, genesis );
+
+      for ( uint32_t row_budget : { gc_default_row_budget, 1u } ){
+         check_ok( as_admin( [&]( chain& c ){ c.setgc( peer_chain, row_budget ); }), "setgc" );
+         uint64_t max_erased = 0, max_uncollected = 0;
+         for ( uint32_t i = 0; i < 30; ++i ){
+            host::reset_stats();
+            check_ok( pushsection( main_relay, sc.next_headers( 100 )), "push 100 headers" );
+            max_erased = std::max( max_erased, host::stats().db_erase.calls );
+
+            auto rows = chaindb_rows();
+            max_uncollected = std::max( max_uncollected, rows.first );
+            check( rows.second, "every header of the last section is stored" );
+            check( singleton_value<gc_state_singleton>().cursor <= last_section().first, "cursor not after the first header" );
+         }
+         std::string budget = "row_budget " + std::to_string( row_budget );
+         check( max_erased <= row_budget + 100, budget + ": at most row_budget rows plus one per pushed header erased" );
+         check( max_erased > 0, budget + ": rows erased" );
+         check( max_uncollected <= 100, budget + ": the garbage collector keeps up with the pushed headers" );
+      }
+   }
+
+   /// the last section is trimmed to a stored blockroot_merkle snapshot and can be pushed again from its first header
+   void test_section_trim() {
+      synthetic_chain sc( 1000 );
+      signed_block_header genesis;
+      setup_light_client( sc, "pipeline"_n, genesis );
+      std::vector<signed_block_header> pushed = { genesis };
+
+      for ( uint32_t i = 0; i < 15; ++i ){
+         auto headers = sc.next_headers( 100 );
+         pushed.insert( pushed.end(), headers.begin(), headers.end() );
+         check_ok( pushsection( main_relay, headers ), "push 100 headers" );
+
+         auto s = last_section();
+         check( s.last - s.first <= lib_depth + 50 + merkle_snapshot_interval, "the last section stays about lib_depth headers long" );
+         check( s.first == genesis.block_num() || s.last - s.first >= lib_depth, "the last section keeps lib_depth headers" );
+         chaindb db( ibc_chain_account, peer_chain.value );
+         auto first = db.find( s.first );
+         check( first != db.end() && first->blockroot_merkle._node_count != 0, "the first header is a stored snapshot" );
+      }
+      check( last_section().first > genesis.block_num(), "the last section has been trimmed" );
+
+      // the whole section pushed again with new headers after it, e.g. by a relay which was behind
+      auto s = last_section();
+      auto headers = std::vector<signed_block_header>( pushed.begin() + ( s.first - genesis.block_num() ), pushed.end() );
+      auto more = sc.next_headers( 10 );
+      headers.insert( headers.end(), more.begin(), more.end() );
+      check_ok( pushsection( main_relay, headers ), "push the last section again from its first header" );
+      check( last_section().last == s.last + 10 && last_section().first >= s.first, "the section pushed again is extended" );
+      check( chaindb_rows().second, "every header of the last section is stored" );
+
+      // headers of pushrounds, some of the block numbers the trim would take are not stored
+      std::vector<signed_block_header> rounds;
+      std::vector<block_id_type> skipped_ids;
+      name last_producer = more.back().producer;
+      std::vector<block_id_type> pending;
+      for ( const auto& h : sc.next_headers( 600 )){
+         if ( h.producer != last_producer ){
+            rounds.push_back( h );
+            skipped_ids.insert( skipped_ids.end(), pending.begin(), pending.end() );
+            pending.clear();
+            last_producer = h.producer;
+         } else {
+            pending.push_back( h.id() );
+         }
+      }
+      check_ok( push_action( { main_relay }, [&]( chain& c ){
+         c.pushrounds( peer_chain, pack( rounds ), skipped_ids, main_relay );
+      }), "pushrounds" );
+      s = last_section();
+      chaindb db( ibc_chain_account, peer_chain.value );
+      auto first = db.find( s.first );
+      check( first != db.end() && first->blockroot_merkle._node_count != 0, "the first header is a stored snapshot after pushrounds" );
+      check( s.last - s.first >= lib_depth - 12, "the section trimmed after pushrounds" );
+   }
+
+   /// after a producer replacement the section is valid again only once a header of the new schedule is irreversible,
+   /// confirmed by 2/3+1 of its producers, and not by the irreversibility reached under the old schedule
+   void test_schedule_replacement() {
+      synthetic_chain sc( 1000 );
+      signed_block_header genesis;
+      setup_light_client( sc, "pipeline"_n, genesis );
+      check_ok( pushsection( main_relay, sc.next_headers( 400 )), "push 400 headers" );
+      check( last_section().valid, "valid before the replacement" );
+
+      // the same producers but the last one, replaced by prod.z
+      std::vector<host::private_key> new_keys;
+      auto new_schedule = synthetic_chain::make_schedule( 0, 21, "prod.", new_keys );
+      new_keys.back() = host::private_key::from_seed( "prod.z" );
+      new_schedule.producers.back() = producer_key{ "prod.z"_n, new_keys.back().get_public_key() };
+
+      auto proposing = sc.next_header_proposing( new_schedule, new_keys );
+      check_ok( pushsection( main_relay, { proposing }), "push a header with new_producers" );
+      check_ok( pushsection( main_relay, sc.next_headers( 300 )), "push the replacement interval" );
+      auto s = last_section();
+      check( ! s.valid && s.proposed_lib_num > proposing.block_num(), "invalid under replacement, with headers irreversible after new_producers" );
+
+      // the first header from the switch on confirmed by 2/3+1 producers makes the section valid
+      sc.activate_pending();
+      auto headers = sc.next_headers( 250 );
+      uint32_t expected_valid_num = irreversible_after( headers, headers.front().block_num() );
+      check( expected_valid_num != 0 && expected_valid_num - proposing.block_num() < lib_depth * 2,
+             "irreversible under the new schedule before the section is valid by its length" );
+
+      for ( const auto& h : headers ){
+         check_ok( pushsection( main_relay, { h }), "push a header under the new schedule" );
+         if ( last_section().valid != ( h.block_num() >= expected_valid_num )){
+            check( false, "valid from the first header irreversible under the new schedule on, not at " + std::to_string( h.block_num() ));
+            break;
+         }
+      }
+      check( last_section().valid, "valid again after the replacement" );
+   }
+
+   /// takes the anchor marking of batched into one_by_one, where every action marked an anchor block: the other anchor
+   /// blocks are unmarked, or dropped if the garbage collector erased them in batched, and the anchor tables are copied
+   void take_anchor_marking( host::database& one_by_one, const host::database& batched ) {
+      for ( name table : { "anchors"_n, "anchormmr"_n, "globalm"_n, "gcstate"_n } ){
+         auto key = std::make_tuple( ibc_chain_account.value, peer_chain.value, table.value );
+         auto itr = batched.find( key );
+         if ( itr != batched.end() ){ one_by_one[key] = itr->second; }
+         else { one_by_one.erase( key ); }
+      }
+
+      auto key = std::make_tuple( ibc_chain_account.value, peer_chain.value, "chaindb"_n.value );
+      auto& rows = one_by_one[key];
+      const auto& kept = batched.at( key );
+      for ( auto itr = rows.begin(); itr != rows.end(); ){
+         auto state = unpack<block_header_state>( itr->second );
+         auto other = kept.find( itr->first );
+         if ( state.is_anchor_block && other == kept.end() ){
+            itr = rows.erase( itr );
+            continue;
+         }
+         if ( state.is_anchor_block && ! unpack<block_header_state>( other->second ).is_anchor_block ){
+            state.is_anchor_block = false;
+            state.blockroot_merkle = unpack<block_header_state>( other->second ).blockroot_merkle;
+            itr->second = pack( state );
+         }
+         ++itr;
+      }
+   }
+
+   /// pushes headers in one pushsection and, from the same tables, one per pushsection, which reads each previous
+   /// header back from chaindb, checks both leave the same tables but the anchor blocks, and keeps those of the single push
+   void check_push_one_by_one( const std::vector<signed_block_header>& headers, const std::string& what ) {
+      auto saved = host::db_save();
+      for ( const auto& h : headers ){
+         check_ok( pushsection( main_relay, { h }), what + ": push header " + std::to_string( h.block_num() ) + " alone" );
+      }
+      auto one_by_one = host::db_save();
+      host::db_load( std::move( saved ));
+      check_ok( pushsection( main_relay, headers ), what + ": push all headers" );
+      take_anchor_marking( one_by_one, host::db_save() );
+      check( host::db_save() == one_by_one, what + ": the same tables after one push and after a push per header" );
+   }
+
+   /// the chain tip an action keeps in memory must leave the tables a push of one header at a time leaves
+   void test_push_one_by_one() {
+      synthetic_chain sc( 1000 );
+      signed_block_header genesis;
+      setup_light_client( sc, "pipeline"_n, genesis );
+      check_ok( as_admin( [&]( chain& c ){ c.setgc( peer_chain, 1000000 ); }), "collect all garbage in each action" );
+      check_push_one_by_one( sc.next_headers( 50 ), "the first headers" );
+      check_ok( pushsection( main_relay, sc.next_headers( 300 )), "push 300 headers" );
+      check_push_one_by_one( sc.next_headers( 150 ), "headers after the lib_depth first ones" );
+
+      // the last section row is written once per action, also when the trim moves its first block number
+      auto first = last_section().first;
+      check_push_one_by_one( sc.next_headers( 200 ), "headers the last section is trimmed by" );
+      check( last_section().first > first, "the last section is trimmed" );
+
+      // and when a schedule change invalidates it and clears its producers
+      std::vector<host::private_key> new_keys;
+      auto new_schedule = synthetic_chain::make_schedule( 0, 21, "prod.", new_keys );
+      new_keys.back() = host::private_key::from_seed( "prod.z" );
+      new_schedule.producers.back() = producer_key{ "prod.z"_n, new_keys.back().get_public_key() };
+      auto headers = sc.next_headers( 20 );
+      headers.push_back( sc.next_header_proposing( new_schedule, new_keys ));
+      auto more = sc.next_headers( 300 );
+      headers.insert( headers.end(), more.begin(), more.end() );
+      check_push_one_by_one( headers, "headers proposing a new schedule" );
+      check( ! last_section().valid, "the last section is invalid under the replacement" );
+   }
+
+   uint64_t staged_rows( const block_id_type& block_id ) {
+      forkdb f( ibc_chain_account, peer_chain.value );
+      uint64_t count = 0;
+      for ( const auto& r : f ){
+         count += is_equal_capi_checksum256( r.state.block_id, block_id ) ? 1 : 0;
+      }
+      return count;
+   }
+
+   bool is_stored( const signed_block_header& header ) {
+      chaindb db( ibc_chain_account, peer_chain.value );
+      auto itr = db.find( header.block_num() );
+      return itr != db.end() && is_equal_capi_checksum256( itr->block_id, header.id() );
+   }
+
+   /// headers already stored are skipped before their signature is verified, pushing them again leaves the tables as they are
+   void test_repeated_headers() {
+      synthetic_chain sc( 1000 );
+      signed_block_header genesis;
+      setup_light_client( sc, "pipeline"_n, genesis );
+      auto headers = sc.next_headers( 100 );
+      check_ok( pushsection( main_relay, headers ), "push 100 headers" );
+
+      auto tables = host::db_save();
+      host::reset_stats();
+      check_ok( pushsection( main_relay, headers ), "push the same headers again" );
+      check( host::stats().assert_recover_key.calls == 0, "no signature of a stored header is verified" );
+      check( host::db_save() == tables, "the tables are unchanged" );
+
+      auto more = sc.next_headers( 20 );
+      std::vector<signed_block_header> overlapping( headers.begin() + 50, headers.end() );
+      overlapping.insert( overlapping.end(), more.begin(), more.end() );
+      host::reset_stats();
+      check_ok( pushsection( main_relay, overlapping ), "push stored headers followed by new ones" );
+      check( host::stats().assert_recover_key.calls == 20, "only the new headers are verified" );
+      check( last_section().last == more.back().block_num(), "the new headers are stored" );
+   }
+
+   /// a competing branch is staged, and replaces the stored headers after its fork point once it is longer, which are
+   /// staged in turn; the producers of staged headers are checked like those of stored ones
+   void test_forks() {
+      synthetic_chain sc( 1000 );
+      signed_block_header genesis;
+      setup_light_client( sc, "pipeline"_n, genesis );
+      check_ok( pushsection( main_relay, sc.next_headers( 380 )), "push 380 headers" );
+      synthetic_chain fork = sc;
+      auto stored = sc.next_headers( 20 );
+      check_ok( pushsection( main_relay, stored ), "push 20 headers" );
+      auto last = last_section().last;
+
+      // a header of the next producer in the slot of the scheduled one
+      synthetic_chain wrong = fork;
+      auto header = wrong.next_header();
+      header.producer = sc.schedule.producers[ ( header.timestamp.slot / producer_repetitions + 1 ) % 21 ].producer_name;
+      wrong.sign( header );
+      check_error( pushsection( main_relay, { header }), "scheduled producer validate failed", "staged header of an unscheduled producer" );
+
+      fork.slot += 1;
+      auto branch = fork.next_headers( 300 );
+      uint32_t fork_num = branch.front().block_num();
+
+      check_ok( pushsection( main_relay, std::vector<signed_block_header>( branch.begin(), branch.begin() + 10 )), "push a fork" );
+      check( rows( "forkdb"_n ) == 10 && last_section().last == last && is_stored( stored.front() ), "a fork is staged" );
+      check_ok( pushsection( main_relay, std::vector<signed_block_header>( branch.begin() + 10, branch.begin() + 20 )),
+                "push the branch up to the last header" );
+      check( rows( "forkdb"_n ) == 20 && last_section().last == last && is_stored( stored.back() ),
+             "a branch as long as the stored one is staged" );
+
+      check_ok( pushsection( main_relay, { branch[20] }), "push the header making the branch the longest" );
+      check( last_section().last == last + 1 && is_stored( branch.front() ) && is_stored( branch[20] ), "the longer branch is promoted" );
+      check( rows( "forkdb"_n ) == 20 && staged_rows( stored.front().id() ) == 1 && staged_rows( stored.back().id() ) == 1,
+             "the replaced headers are staged" );
+
+      // the replaced branch comes back once it is the longest, its staged headers are not pushed again
+      synthetic_chain back = sc;
+      auto back_headers = back.next_headers( 2 );
+      host::reset_stats();
+      check_ok( pushsection( main_relay, back_headers ), "extend the replaced branch" );
+      check( host::stats().assert_recover_key.calls == 2, "only the pushed headers are verified" );
+      check( last_section().last == last + 2 && is_stored( stored.front() ) && is_stored( back_headers.back() ),
+             "the replaced branch is promoted back" );
+      check( rows( "forkdb"_n ) == 21 && staged_rows( branch[20].id() ) == 1, "the other branch is staged again" );
+
+      host::reset_stats();
+      check_ok( pushsection( main_relay, std::vector<signed_block_header>( branch.begin() + 21, branch.begin() + 23 )),
+                "extend the other branch" );
+      check( host::stats().assert_recover_key.calls == 2 && last_section().last == last + 3 && is_stored( branch[22] ),
+             "the other branch is promoted back without verifying its staged headers again" );
+
+      check_ok( pushsection( main_relay, std::vector<signed_block_header>( branch.begin() + 23, branch.end() )),
+                "push the rest of the branch" );
+      check( last_section().last == branch.back().block_num() && rows( "forkdb"_n ) == 0, "the replaced branch is collected" );
+      check( last_section().proposed_lib_num >= fork_num, "irreversible after the fork point" );
+
+      // a side branch is collected once it forks more than fork_staging_depth blocks behind the last header
+      synthetic_chain side = fork;
+      side.slot += 1;
+      auto side_headers = side.next_headers( 5 );
+      auto rest = fork.next_headers( 40 );
+      check_ok( pushsection( main_relay, std::vector<signed_block_header>( rest.begin(), rest.begin() + 5 )), "push 5 headers" );
+      check_ok( pushsection( main_relay, side_headers ), "push a side branch" );
+      check( rows( "forkdb"_n ) == 5, "the side branch is staged" );
+      check_ok( pushsection( main_relay, std::vector<signed_block_header>( rest.begin() + 5, rest.begin() + 20 )), "push 15 headers" );
+      check( rows( "forkdb"_n ) == 5, "the side branch is kept while it forks less than fork_staging_depth blocks behind" );
+      check_ok( pushsection( main_relay, std::vector<signed_block_header>( rest.begin() + 20, rest.end() )), "push 20 headers" );
+      check( rows( "forkdb"_n ) == 0, "the side branch is collected" );
+   }
+
+   /// producers confirming only their own blocks make nothing irreversible, a near-tip fork still takes over once it is the
+   /// longest, and forkdb stays bounded
+   void test_fork_without_confirmations() {
+      synthetic_chain sc( 1000 );
+      sc.confirming = false;
+      signed_block_header genesis;
+      setup_light_client( sc, "pipeline"_n, genesis );
+      check_ok( pushsection( main_relay, sc.next_headers( 378 )), "push 378 headers" );
+      synthetic_chain fork = sc;
+      check_ok( pushsection( main_relay, sc.next_headers( 2 )), "push 2 headers" );
+
+      fork.slot += 1;
+      uint64_t max_staged = 0;
+      for ( uint32_t i = 0; i < 10; ++i ){
+         check_ok( pushsection( main_relay, fork.next_headers( 100 )), "push 100 headers of the fork" );
+         max_staged = std::max( max_staged, rows( "forkdb"_n ));
+      }
+      check( last_section().last == block_header::num_from_id( fork.last_id ), "the stored tip follows the longer branch" );
+      check( max_staged <= fork_staging_depth + 1 && rows( "forkdb"_n ) == 0, "forkdb stays bounded and is collected" );
+   }
+
+   /// a fork whose parent was skipped by pushrounds can neither be staged nor replace the stored headers
+   void test_fork_after_rounds() {
+      synthetic_chain sc( 1000 );
+      signed_block_header genesis;
+      setup_light_client( sc, "pipeline"_n, genesis );
+      auto pushed = sc.next_headers( 100 );
+      check_ok( pushsection( main_relay, pushed ), "push 100 headers" );
+
+      synthetic_chain fork = sc;
+      auto headers = sc.next_headers( 200 );
+      std::vector<signed_block_header> rounds;
+      std::vector<block_id_type> skipped_ids, pending;
+      std::set<uint32_t> skipped_nums;
+      name last_producer = pushed.back().producer;
+      for ( const auto& h : headers ){
+         if ( h.producer != last_producer ){
+            rounds.push_back( h );
+            skipped_ids.insert( skipped_ids.end(), pending.begin(), pending.end() );
+            pending.clear();
+            last_producer = h.producer;
+         } else {
+            pending.push_back( h.id() );
+            skipped_nums.insert( h.block_num() );
+         }
+      }
+      check_ok( push_action( { main_relay }, [&]( chain& c ){
+         c.pushrounds( peer_chain, pack( rounds ), skipped_ids, main_relay );
+      }), "pushrounds" );
+
+      // forks after a skipped header more than fork_staging_depth blocks behind the last header
+      size_t k = 50;
+      while ( ! skipped_nums.count( headers[k - 1].block_num() )){ ++k; }
+      check( headers[k].block_num() + fork_staging_depth <= last_section().last, "the fork point is deep" );
+      fork.next_headers( k );
+      fork.slot += 1;
+      auto forked = fork.next_header();
+      check_error( pushsection( main_relay, { forked }), "fork point is too old", "fork after a header skipped by pushrounds" );
+   }
+
+   std::vector<anchor_block> anchor_rows() {
+      anchors a( ibc_chain_account, peer_chain.value );
+      return std::vector<anchor_block>( a.begin(), a.end() );
+   }
+
+   /// anchor blocks are appended to anchormmr once they are irreversible, one a fork erases before is never appended,
+   /// and an appended one is accepted from its path in anchormmr
+   void test_anchor_irreversibility() {
+      synthetic_chain sc( 1000 );
+      sc.confirming = false;
+      signed_block_header genesis;
+      setup_light_client( sc, "pipeline"_n, genesis );
+      check_ok( pushsection( main_relay, sc.next_headers( 50 )), "push 50 headers" );
+      synthetic_chain fork = sc;
+      for ( uint32_t i = 0; i < 7; ++i ){
+         check_ok( pushsection( main_relay, sc.next_headers( 50 )), "push 50 headers" );
+      }
+      auto erased_num = singleton_value<global_mutable_singleton>().last_anchor_block_num;
+      check( erased_num > block_header::num_from_id( fork.last_id ) + 1, "an anchor block after the fork point" );
+      uint64_t pending = 0;
+      for ( const auto& r : anchor_rows() ){ pending += r.leaf_index == mmr_pending_leaf ? 1 : 0; }
+      check( pending == rows( "anchors"_n ) - 1 && pending > 1, "anchor blocks lib_depth deep but not irreversible are pending" );
+      check( singleton_value<anchor_mmr_singleton>().leaf_count == 1, "only the first header is in anchormmr" );
+
+      fork.slot += 1;
+      check_ok( pushsection( main_relay, fork.next_headers( 10 )), "fork before the pending anchor block" );
+      anchors a( ibc_chain_account, peer_chain.value );
+      check( a.find( erased_num ) == a.end(), "the pending anchor block is erased by the fork" );
+
+      fork.confirming = true;
+      for ( uint32_t i = 0; i < 8; ++i ){
+         check_ok( pushsection( main_relay, fork.next_headers( 50 )), "push 50 headers" );
+      }
+      auto mmr = singleton_value<anchor_mmr_singleton>();
+      auto s = last_section();
+      std::vector<digest_type> leaves;
+      std::vector<anchor_block> appended;
+      for ( const auto& r : anchor_rows() ){
+         check( r.block_num != erased_num, "the erased anchor block is not stored again" );
+         if ( r.leaf_index == mmr_pending_leaf ){
+            check( r.block_num > s.proposed_lib_num, "pending anchor blocks are not irreversible" );
+            continue;
+         }
+         check( r.leaf_index == leaves.size() && ( r.block_num <= s.proposed_lib_num || r.block_num < s.first ),
+                "irreversible anchor blocks appended in block number order" );
+         leaves.push_back( get_checksum256( r ));
+         appended.push_back( r );
+      }
+      check( mmr.leaf_count == leaves.size() && leaves.size() > 2, "anchormmr holds the irreversible anchor blocks" );
+      check( pack( mmr.peaks ) == pack( reference_mmr( leaves, 0 ).first ), "peaks of the irreversible anchor blocks" );
+
+      // the proof ibc.token cash and cashconfirm accept for an anchor block erased from table anchors
+      auto get_anchor = [&]( uint32_t block_num, const anchor_mmr_proof& proof, anchor_block& anchor ){
+         try {
+            anchor = chain::get_anchor_block( ibc_chain_account, peer_chain, block_num, pack( proof ));
+            return std::string();
+         } catch ( const eosio_assert_exception& e ) {
+            return std::string( e.what() );
+         }
+      };
+      anchor_mmr_proof proof{ appended[1], reference_mmr( leaves, 1 ).second };
+      anchor_block anchor;
+      check_ok( get_anchor( appended[1].block_num, proof, anchor ), "anchor block from its proof" );
+      check( pack( anchor ) == pack( appended[1] ), "the anchor block of the proof" );
+      check_error( get_anchor( appended[2].block_num, proof, anchor ), "anchor_mmr_proof is not of the anchor block", "proof of another block" );
+      auto wrong = proof;
+      wrong.anchor.leaf_index = 2;
+      check_error( get_anchor( appended[1].block_num, wrong, anchor ), "is not a historical anchor block", "proof with a wrong leaf_index" );
+      wrong = proof;
+      wrong.anchor.transaction_mroot = make_id( 1, "tampered" );
+      check_error( get_anchor( appended[1].block_num, wrong, anchor ), "is not a historical anchor block", "proof of a tampered anchor block" );
+   }
+
+   /// an anchor block the garbage collector has erased is stored again by restoreanchor from its path in anchormmr,
+   /// and erased again by the next garbage collection
+   void test_restore_anchor() {
+      synthetic_chain sc( 1000 );
+      signed_block_header genesis;
+      setup_light_client( sc, "pipeline"_n, genesis );
+
+      // the rows a relay keeps, by leaf index, until the garbage collector erases the row of the first anchor block
+      std::map<uint64_t, anchor_block> kept;
+      auto stored_anchor = []( uint64_t block_num ){   // a table instance per read, an action which fails reloads the tables
+         anchors a( ibc_chain_account, peer_chain.value );
+         auto itr = a.find( block_num );
+         return itr != a.end() ? std::optional<anchor_block>( *itr ) : std::nullopt;
+      };
+      for ( uint32_t i = 0; i < 40 && stored_anchor( genesis.block_num() ); ++i ){
+         check_ok( pushsection( main_relay, sc.next_headers( 300 )), "push 300 headers" );
+         for ( const auto& r : anchor_rows() ){
+            if ( r.leaf_index != mmr_pending_leaf ){ kept[r.leaf_index] = r; }
+         }
+      }
+      check( ! stored_anchor( genesis.block_num() ), "the first anchor block is erased after chaindb_max_history_length" );
+
+      std::vector<digest_type> leaves;
+      for ( const auto& k : kept ){
+         check( k.first == leaves.size(), "kept rows have consecutive leaf indices" );
+         leaves.push_back( get_checksum256( k.second ));
+      }
+      check( singleton_value<anchor_mmr_singleton>().leaf_count == leaves.size(), "the relay kept every appended row" );
+      auto first = kept[0];
+      auto path = reference_mmr( leaves, 0 ).second;
+
+      auto restore = [&]( const anchor_block& anchor, const std::vector<digest_type>& mmr_path ){
+         return push_action( { main_relay }, [&]( chain& c ){ c.restoreanchor( peer_chain, anchor, mmr_path, main_relay ); });
+      };
+      auto wrong_path = path;
+      wrong_path.back() = make_id( 1, "wrong" );
+      check_error( restore( first, wrong_path ), "anchor block not in table anchormmr", "restore with a wrong path" );
+      auto wrong_index = first;
+      wrong_index.leaf_index = 1;
+      check_error( restore( wrong_index, path ), "anchor block not in table anchormmr", "restore with a wrong leaf_index" );
+
+      check_ok( restore( first, path ), "restoreanchor" );
+      check( stored_anchor( first.block_num ) && pack( *stored_anchor( first.block_num )) == pack( first ), "the anchor block is stored again" );
+      check( pack( chain::get_anchor_block( ibc_chain_account, peer_chain, first.block_num, {} )) == pack( first ),
+             "the restored anchor block is read from table anchors" );
+      check_error( restore( first, path ), "anchor block already exists", "restore twice" );
+
+      check_ok( pushsection( main_relay, sc.next_headers( 10 )), "push 10 headers" );
+      check( ! stored_anchor( first.block_num ) && singleton_value<gc_state_singleton>().restored_anchors.empty(),
+             "the restored anchor block is erased by the next garbage collection" );
+   }
+
+   std::string bootstrap( const light_client_checkpoint& cp ) {
+      return push_action( { main_relay }, [&]( chain& c ){ c.bootstrap( peer_chain, cp, main_relay ); });
+   }
+
+   /// a checkpoint of one light client starts another one at its anchor block, a tampered checkpoint is rejected
+   void test_checkpoint() {
+      synthetic_chain sc( 1000 );
+      signed_block_header genesis;
+      setup_light_client( sc, "pipeline"_n, genesis );
+      std::vector<signed_block_header> pushed = sc.next_headers( 600 );
+      pushed.insert( pushed.begin(), genesis );
+      check_ok( pushsection( main_relay, { pushed.begin() + 1, pushed.end() }), "push 600 headers" );
+      check_ok( push_action( { main_relay }, [&]( chain& c ){ c.checkpoint( peer_chain, main_relay ); }), "checkpoint" );
+      auto cp = singleton_value<checkpoint_singleton>();
+      auto anchor_num = singleton_value<global_mutable_singleton>().last_anchor_block_num;
+      check( cp.anchor_header.block_num() == anchor_num, "checkpoint at the last anchor block" );
+      anchor_block anchor;
+      {
+         anchors a( ibc_chain_account, peer_chain.value );
+         anchor = a.get( anchor_num );
+         anchor.leaf_index = 0;   // the first leaf of the anchormmr of the bootstrapped light client
+      }
+      auto next = sc.next_headers( 10 );
+
+      create_light_client( sc, "pipeline"_n );
+      auto tampered = cp;
+      tampered.anchor_header.transaction_mroot = make_id( 1, "tampered" );
+      check_error( bootstrap( tampered ), "Error expected key different than recovered key", "tampered anchor header" );
+      tampered = cp;
+      tampered.blockroot_merkle.append( make_id( 1, "tampered" ));
+      check_error( bootstrap( tampered ), "Error expected key different than recovered key", "tampered blockroot_merkle" );
+      tampered = cp;
+      std::swap( tampered.active_schedule.producers[0].block_signing_key, tampered.active_schedule.producers[1].block_signing_key );
+      tampered.pending_schedule = tampered.active_schedule;
+      check( bootstrap( tampered ).size() > 0, "tampered active schedule" );
+      tampered = cp;
+      tampered.chain_id = make_id( 1, "other chain" );
+      check_error( bootstrap( tampered ), "chain_id of the checkpoint not match", "checkpoint of another chain" );
+      tampered = cp;
+      tampered.section.valid = false;
+      check_error( bootstrap( tampered ), "section of the checkpoint must be valid", "invalid section without a producer replacement" );
+      check( rows( "chaindb"_n ) == 0 && rows( "sections"_n ) == 0, "rejected checkpoints store nothing" );
+
+      host::watch_sha256_length( pack_size( static_cast<const block_header&>( cp.anchor_header )));
+      host::reset_stats();
+      check_ok( bootstrap( cp ), "bootstrap" );
+      check( host::stats().sha256_watched.calls == 1, "the anchor header is hashed once" );
+      host::watch_sha256_length( 0 );
+      check_error( bootstrap( cp ), "the light client has already been initialized", "bootstrap twice" );
+      {
+         anchors a( ibc_chain_account, peer_chain.value );
+         auto row = a.find( anchor_num );
+         check( row != a.end() && pack( *row ) == pack( anchor ), "the anchor block is usable at once" );
+      }
+      check( last_section().valid && last_section().first == anchor_num, "valid section at the anchor block" );
+
+      // the headers after the anchor block continue the bootstrapped light client
+      std::vector<signed_block_header> headers( pushed.begin() + ( anchor_num - genesis.block_num() ), pushed.end() );
+      headers.insert( headers.end(), next.begin(), next.end() );
+      check_ok( pushsection( main_relay, headers ), "push the headers after the anchor block" );
+      check( last_section().last == block_header::num_from_id( sc.last_id ), "bootstrapped light client extended" );
+   }
+
+   /// turn n belongs to the relay n % 2 of table relays, any relay may take over an unserved turn after takeover_timeout
+   void test_relay_turns() {
+      synthetic_chain sc( 1000 );
+      signed_block_header genesis;
+      setup_light_client( sc, "pipeline"_n, genesis );
+      host::add_account( other_relay );
+      check_ok( as_admin( [&]( chain& c ){ c.relay( peer_chain, "add", other_relay ); }), "add other_relay" );
+      check_ok( as_admin( [&]( chain& c ){ c.setturns( peer_chain, 100, 30 ); }), "setturns" );
+      check_error( as_admin( [&]( chain& c ){ c.setturns( peer_chain, 100, 100 ); }), "takeover_timeout must be less",
+                   "setturns with takeover_timeout not less than turn_length" );
+
+      auto headers = sc.next_headers( 60 );
+      auto part = [&]( uint32_t i ){ return std::vector<signed_block_header>( headers.begin() + i * 10, headers.begin() + i * 10 + 10 ); };
+
+      host::set_time( 1000 );   // turn 10, of other_relay
+      check_error( pushsection( main_relay, part(0) ), "not the turn of this relay", "push in the turn of another relay" );
+
+      host::set_time( 1040 );
+      check_ok( pushsection( main_relay, part(0) ), "takeover after takeover_timeout" );
+      check_ok( pushsection( other_relay, part(1) ), "push in its own turn after a takeover" );
+      check( singleton_value<relay_turn_singleton>().served_turn == 10, "the turn is served by its own relay" );
+
+      host::set_time( 1060 );
+      check_error( pushsection( main_relay, part(2) ), "not the turn of this relay", "takeover of a served turn" );
+      host::reset_stats();
+      check_error( pushsection( main_relay, part(1) ), "not the turn of this relay", "stored headers pushed out of turn" );
+      check( host::stats().assert_recover_key.calls == 0 && host::stats().sha256.calls == 0,
+             "a push out of turn fails before any header is hashed or verified" );
+
+      // a push which stores nothing does not serve the turn, the other relay can still take it over
+      host::set_time( 1210 );   // turn 12, of other_relay
+      check_ok( pushsection( other_relay, part(1) ), "headers already stored pushed in its own turn" );
+      check( singleton_value<relay_turn_singleton>().served_turn == 10, "pushing stored headers does not serve a turn" );
+      host::set_time( 1240 );
+      check_ok( pushsection( main_relay, part(2) ), "takeover of a turn whose relay pushed only stored headers" );
+
+      host::set_time( 1350 );   // turn 13, of main_relay
+      check_ok( pushsection( main_relay, part(3) ), "push in the next turn" );
+      check( singleton_value<relay_turn_singleton>().served_turn == 13, "served_turn follows the turns" );
+
+      check_ok( as_admin( [&]( chain& c ){ c.setturns( peer_chain, 0, 0 ); }), "disable turns" );
+      check_ok( pushsection( other_relay, part(4) ), "push with turns disabled" );
+      host::set_time( 0 );
+   }
+
+   /// a reset erases at most row_budget rows per action, chaininit of a relay continues it and initializes once it is finished
+   void test_reset() {
+      synthetic_chain sc( 1000 );
+      signed_block_header genesis;
+      setup_light_client( sc, "pipeline"_n, genesis );
+      check_ok( pushsection( main_relay, sc.next_headers( 400 )), "push 400 headers" );
+      check_ok( as_admin( [&]( chain& c ){ c.setgc( peer_chain, 50 ); }), "setgc" );
+
+      uint64_t light_client_rows = rows( "sections"_n ) + rows( "prodsches"_n ) + rows( "chaindb"_n ) + rows( "forkdb"_n ) + rows( "anchors"_n );
+      check( light_client_rows > 100, "more rows than two budgets" );
+
+      check_error( push_action( { main_relay }, [&]( chain& c ){ c.forceinit( peer_chain ); }), "admin account not exist",
+                   "forceinit by a relay" );
+      check_ok( as_admin( [&]( chain& c ){ c.forceinit( peer_chain ); }), "forceinit" );
+      check( singleton_value<reset_state_singleton>().stage != name(), "reset in progress after one budget" );
+      check( singleton_value<reset_state_singleton>().rows_erased == 50, "row_budget rows erased" );
+      check_error( pushsection( main_relay, { sc.next_header() }), "the light client is being reset", "push during a reset" );
+
+      auto header = sc.next_header();
+      auto merkle = sc.merkle;
+      uint32_t calls = 0;
+      do {
+         ++calls;
+         check_ok( push_action( { main_relay }, [&]( chain& c ){
+            c.chaininit( peer_chain, pack( header ), sc.schedule, merkle, main_relay );
+         }), "chaininit during a reset" );
+      } while ( calls < 100 && singleton_value<reset_state_singleton>().stage != name() );
+      check( calls == ( light_client_rows - 50 + 49 ) / 50, "chaininit erases row_budget rows per call" );
+      check( singleton_value<reset_state_singleton>().stage == name(), "reset finished" );
+      check( singleton_value<reset_state_singleton>().rows_erased == light_client_rows, "all rows erased" );
+      check( rows( "chaindb"_n ) == 1 && rows( "anchors"_n ) == 1 && rows( "sections"_n ) == 1 && rows( "prodsches"_n ) == 1,
+             "initialized again" );
+      check( singleton_value<anchor_mmr_singleton>().leaf_count == 1, "anchormmr restarts" );
+
+      check_error( push_action( { main_relay }, [&]( chain& c ){
+         c.chaininit( peer_chain, pack( header ), sc.schedule, merkle, main_relay );
+      }), "the light client has already been initialized", "chaininit twice" );
+      check_ok( pushsection( main_relay, sc.next_headers( 10 )), "push after the reset" );
+      check( last_section().first == header.block_num() && last_section().last == header.block_num() + 10, "section after the reset" );
+   }
+
+   /// the tables are scoped by the chain_name setglobal initializes, setadmin alone has no chain_name
+   void test_chain_scopes() {
+      synthetic_chain sc( 1000 );
+      create_light_client( sc, "pipeline"_n );
+      const name other_chain = "otherchain"_n;
+      const name admin = "ibc2admin555"_n;
+      host::add_account( admin );
+      check( rows( "global"_n ) == 1 && rows( "globalm"_n ) == 0 && rows( "gcstate"_n ) == 0 && rows( "wtmsig"_n ) == 0,
+             "setglobal writes only the singleton it changed" );
+
+      check_error( push_action( { ibc_chain_account }, [&]( chain& c ){ c.relay( other_chain, "add", main_relay ); }, pack( other_chain )),
+                   "chain_name not initialized", "relay on a chain_name without setglobal" );
+      check_error( push_action( { ibc_chain_account }, [&]( chain& c ){ c.relay( peer_chain, "add", other_relay ); }, pack( other_chain )),
+                   "chain_name must be the first argument", "chain_name other than the scope" );
+
+      check_ok( push_action( { ibc_chain_account }, [&]( chain& c ){ c.setadmin( admin ); }, pack( admin )), "setadmin" );
+      check( admin_singleton( ibc_chain_account, ibc_chain_account.value ).get().admin == admin, "admin stored in scope _self" );
+      check( rows( "admin"_n ) == 1 && rows( "global"_n ) == 1, "setadmin writes the admin row only" );
+
+      host::reset_stats();
+      check_ok( push_action( { admin }, [&]( chain& c ){ c.relay( peer_chain, "add", other_relay ); }), "add a relay as admin" );
+      check( host::stats().db_write.calls == 1, "an action writes no unchanged singleton" );
+
+      check_ok( push_action( { ibc_chain_account }, [&]( chain& c ){
+         c.setglobal( other_chain, make_id( 0, "other_chain_id" ), "batch"_n, false, 0 );
+      }, pack( other_chain )), "setglobal of a second chain" );
+      check_ok( push_action( { admin }, [&]( chain& c ){ c.relay( other_chain, "add", main_relay ); }, pack( other_chain )),
+                "relay of the second chain" );
+      check( rows( "global"_n ) == 2 && rows( "relays"_n ) == 3, "each chain has its own tables" );
+   }
+
+   void run( const char* name, void (*test)() ) {
+      printf( "%s\n", name );
+      try {
+         test();
+      } catch ( const eosio_assert_exception& e ) {
+         check( false, std::string("assertion failure: ") + e.what() );
+      }
+   }
+
+} /// namespace
+
+int main() {
+   run( "checksum256", test_checksum256 );
+   run( "merkle", test_merkle );
+   run( "anchor mmr", test_anchor_mmr );
+   run( "anchor lookups", test_anchor_lookups );
+   run( "producer index", test_producer_index );
+   run( "one producer batch", test_one_producer_batch );
+   run( "pbft proofs", test_pbft_proofs );
+   run( "batch in memory", test_batch_in_memory );
+   run( "garbage collection", test_garbage_collection );
+   run( "section trim", test_section_trim );
+   run( "schedule replacement", test_schedule_replacement );
+   run( "push one by one", test_push_one_by_one );
+   run( "repeated headers", test_repeated_headers );
+   run( "forks", test_forks );
+   run( "fork without confirmations", test_fork_without_confirmations );
+   run( "fork after rounds", test_fork_after_rounds );
+   run( "anchor irreversibility", test_anchor_irreversibility );
+   run( "restore anchor", test_restore_anchor );
+   run( "checkpoint", test_checkpoint );
+   run( "relay turns", test_relay_turns );
+   run( "reset", test_reset );
+   run( "chain scopes", test_chain_scopes );
+
+   printf( failures == 0 ? "all tests passed\n" : "%u checks failed\n", failures );
+   return failures == 0 ? 0 : 1;
+}